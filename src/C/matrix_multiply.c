@@ -2,6 +2,9 @@
 // OpenMP library header
 #include <omp.h>
 
+// Counter-based random numbers, the same matrices on every run
+#include "philox.h"
+
 // Timing support
 #include <time.h>
 
@@ -9,6 +12,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// Seed of the random matrices
+#define SEED 2012
+
 double matrix_multiply_test(int N, int method)
 {
     int i, j, k;
@@ -16,13 +22,16 @@ double matrix_multiply_test(int N, int method)
 
     clock_t start, end;
 
-    // Create randomized matrices of the requested size
-    for (i=1 ; i < N ; i++)
-        for (j=1 ; j < N ; j++)
-            A[i][j] = rand();
-            B[i][j] = rand();
+    // Create randomized matrices of the requested size, A from stream 0 and
+    // B from stream 1, one row at a time
+    for (i=0 ; i < N ; i++)
+    {
+        philox_uniform(SEED, 0, (uint64_t)i * N, N, A[i]);
+        philox_uniform(SEED, 1, (uint64_t)i * N, N, B[i]);
+        for (j=0 ; j < N ; j++)
             C[i][j] = 0.0;
-    
+    }
+
 
     // Start timer and compute matrix product
     start = clock();
@@ -0,0 +1,128 @@
+/*
+    Batches of small matrix products, C_b = A_b B_b for b = 1, ..., batch.
+
+    Usage: batched_gemm [size] [batch] [threads]
+
+    size is 4, 8, 16 or 32 (square matrices).  The same batch is multiplied
+    with
+        dgemm       one BLAS dgemm call per product
+        small       small::gemm<size, size, size> per product (small_gemm.h)
+        batched     small::gemm_batched on the interleaved layout, OpenMP
+                    over the batch, interleaving not timed
+    and the GFLOP/s of each and the largest difference from dgemm reported.
+    The dgemm and small loops also run over the batch with OpenMP.
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+// Small matrices with sizes known at compile time
+#include "small_gemm.h"
+// Counter-based random numbers for the matrices
+#include "philox.h"
+
+// System BLAS
+#include <cblas.h>
+
+// Standard IO libraries
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <math.h>
+
+// Seed of the random matrices
+uint64_t const SEED = 2012;
+
+// Seconds per pass of the fastest of a few passes
+template <class F>
+double best_time(F pass)
+{
+    double best = 1e30;
+    for (int repeat = 0; repeat < 5; ++repeat)
+    {
+        double start = omp_get_wtime();
+        pass();
+        best = fmin(best, omp_get_wtime() - start);
+    }
+    return best;
+}
+
+template <int S>
+void batched_gemm_test(long int batch)
+{
+    size_t entries = (size_t)batch * S * S;
+    vector<double> A(entries), B(entries), C_blas(entries), C_small(entries), C_batched(entries);
+    philox_uniform(SEED, 0, 0, (long int)entries, A.data());
+    philox_uniform(SEED, 1, 0, (long int)entries, B.data());
+
+    double blas_time = best_time([&]
+    {
+        #pragma omp parallel for schedule(static)
+        for (long int b = 0; b < batch; ++b)
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, S, S, S, 1.0, &A[b * S * S], S,
+                        &B[b * S * S], S, 0.0, &C_blas[b * S * S], S);
+    });
+
+    double small_time = best_time([&]
+    {
+        #pragma omp parallel for schedule(static)
+        for (long int b = 0; b < batch; ++b)
+            small::gemm<S, S, S>(&A[b * S * S], &B[b * S * S], &C_small[b * S * S]);
+    });
+
+    vector<double> A_interleaved(small::interleaved_size(batch, S * S));
+    vector<double> B_interleaved(A_interleaved.size()), C_interleaved(A_interleaved.size());
+    small::interleave<S, S>(batch, A.data(), A_interleaved.data());
+    small::interleave<S, S>(batch, B.data(), B_interleaved.data());
+    double batched_time = best_time([&]
+    {
+        small::gemm_batched<S, S, S>(batch, A_interleaved.data(), B_interleaved.data(), C_interleaved.data());
+    });
+    small::deinterleave<S, S>(batch, C_interleaved.data(), C_batched.data());
+
+    double small_error = 0.0, batched_error = 0.0;
+    for (size_t e = 0; e < entries; ++e)
+    {
+        small_error = fmax(small_error, fabs(C_small[e] - C_blas[e]));
+        batched_error = fmax(batched_error, fabs(C_batched[e] - C_blas[e]));
+    }
+
+    double flops = 2.0 * S * S * S * batch;
+    cout << S << "x" << S << " matrices, batch of " << batch << " on " << omp_get_max_threads() << " threads:\n";
+    cout << "    dgemm:   " << flops / blas_time / 1e9 << " GFLOP/s\n";
+    cout << "    small:   " << flops / small_time / 1e9 << " GFLOP/s, " << blas_time / small_time;
+    cout << "x dgemm, max difference " << small_error << "\n";
+    cout << "    batched: " << flops / batched_time / 1e9 << " GFLOP/s, " << blas_time / batched_time;
+    cout << "x dgemm, max difference " << batched_error << "\n";
+}
+
+int main(int argc, char* argv[])
+{
+    int size = (argc > 1) ? stoi(argv[1]) : 8;
+    long int batch = (argc > 2) ? stol(argv[2]) : 100000;
+    int threads = (argc > 3) ? stoi(argv[3]) : 1;
+    omp_set_num_threads(threads);
+
+    switch (size)
+    {
+        case 4:
+            batched_gemm_test<4>(batch);
+            break;
+        case 8:
+            batched_gemm_test<8>(batch);
+            break;
+        case 16:
+            batched_gemm_test<16>(batch);
+            break;
+        case 32:
+            batched_gemm_test<32>(batch);
+            break;
+        default:
+            cout << "*** ERROR *** Sizes are 4, 8, 16 or 32!\n";
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+/*
+    Thread pinning and NUMA placement queries (Linux only).
+
+    The kernel places a page on the NUMA node of the CPU that first writes to
+    it, so a thread that initializes exactly the data it will later work on
+    keeps its memory traffic on its own socket - provided the thread does not
+    migrate afterwards.  These helpers pin threads and let a program check
+    where its threads and pages actually ended up.
+
+    On other platforms pinning is a no-op and all queries report node -1.
+*/
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// NUMA node of a CPU from the nodeM link in /sys/devices/system/cpu/cpuN,
+// -1 if unknown
+inline int cpu_node(int cpu)
+{
+    int node = -1;
+#ifdef __linux__
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    DIR* dir = opendir(path.c_str());
+    if (dir == NULL)
+        return -1;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+        if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(entry->d_name[4]))
+            node = atoi(entry->d_name + 4);
+    closedir(dir);
+#endif
+    return node;
+}
+
+// CPU the calling thread is running on right now
+inline int current_cpu()
+{
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+// CPUs this process is allowed to run on, ordered by NUMA node so that
+// consecutive threads fill one node before moving on to the next
+inline std::vector<int> allowed_cpus()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &mask))
+                cpus.push_back(cpu);
+#endif
+    std::vector<int> nodes(cpus.size());
+    for (size_t i = 0; i < cpus.size(); ++i)
+        nodes[i] = cpu_node(cpus[i]);
+    std::vector<size_t> order(cpus.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t i, size_t j) { return nodes[i] < nodes[j]; });
+
+    std::vector<int> sorted;
+    for (size_t i = 0; i < order.size(); ++i)
+        sorted.push_back(cpus[order[i]]);
+    return sorted;
+}
+
+// Pin the calling thread to a single CPU, returns false on failure
+inline bool pin_to_cpu(int cpu)
+{
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu, &mask);
+    return sched_setaffinity(0, sizeof(mask), &mask) == 0;
+#else
+    return false;
+#endif
+}
+
+// NUMA node holding each page in [start, end), -1 for pages that have not
+// been touched yet (or on failure).  Uses move_pages(2) in query mode.
+inline std::vector<int> page_nodes(const void* start, const void* end)
+{
+    long page_size = 4096;
+#ifdef __linux__
+    page_size = sysconf(_SC_PAGESIZE);
+#endif
+    char* first = (char*)((unsigned long)start & ~(page_size - 1));
+    std::vector<void*> pages;
+    for (char* p = first; p < (char*)end; p += page_size)
+        pages.push_back(p);
+
+    std::vector<int> status(pages.size(), -1);
+#ifdef __linux__
+    if (!pages.empty() &&
+        syscall(SYS_move_pages, 0, (unsigned long)pages.size(), pages.data(), NULL, status.data(), 0) != 0)
+        std::fill(status.begin(), status.end(), -1);
+#endif
+    for (size_t i = 0; i < status.size(); ++i)
+        if (status[i] < 0)
+            status[i] = -1;
+    return status;
+}
+
+#endif
@@ -0,0 +1,202 @@
+/*
+    Barriers for tight iterative loops.
+
+    DisseminationBarrier is a dissemination barrier (Hensgen, Finkel and
+    Manber) built for loops whose iterations are only a few microseconds long,
+    like the coarse grain Jacobi sweep.  With P threads it runs ceil(log2 P)
+    rounds; in round r thread i signals thread (i + 2^r) mod P and waits to be
+    signalled by thread (i - 2^r) mod P.  No thread ever waits on a shared
+    counter, every flag has exactly one writer and one reader and lives on its
+    own cache line.
+
+    Instead of flipping a sense bit each flag counts barrier episodes, which
+    is the same idea as sense reversal but never needs the flags to be reset.
+    A waiter first spins on its flag for spin_count polls and then goes to
+    sleep on it with a futex, so short waits stay in user space while long
+    ones (oversubscription, a preempted thread) do not burn a core.  The spin
+    count can also be set through the BARRIER_SPIN_COUNT environment variable;
+    by default it drops to a token amount when there are more threads than
+    CPUs available to the process, since then the thread we are waiting for
+    cannot run while we spin.
+
+    The barrier only needs each caller's index in [0, num_threads) so the
+    same object works inside an OpenMP parallel region and with std::thread.
+
+    OmpBarrier wraps the OpenMP runtime's barrier behind the same interface so
+    code can be written once for either.
+*/
+
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <atomic>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <thread>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "reduction.h"
+
+// Default number of polls before a waiter goes to sleep
+#define BARRIER_DEFAULT_SPIN_COUNT 4000
+#define BARRIER_OVERSUBSCRIBED_SPIN_COUNT 16
+
+// Number of CPUs this process may run on
+inline int available_cpus()
+{
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        return CPU_COUNT(&mask);
+#endif
+    return std::thread::hardware_concurrency();
+}
+
+// Tell the CPU we are in a spin loop
+inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Sleep while *address == expected, wake sleepers on address
+inline void futex_wait(std::atomic<uint32_t>* address, uint32_t expected)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)address, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    std::this_thread::yield();
+#endif
+}
+
+inline void futex_wake(std::atomic<uint32_t>* address)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)address, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+class OmpBarrier
+{
+public:
+    void wait(int thread_ID)
+    {
+        #pragma omp barrier
+    }
+};
+
+class DisseminationBarrier
+{
+public:
+
+    DisseminationBarrier(int num_threads, int spin_count = -1)
+        : num_threads(num_threads), num_rounds(rounds(num_threads)),
+          flags(num_threads * num_rounds), episode(num_threads)
+    {
+        this->spin_count = spin_count;
+        if (spin_count < 0)
+        {
+            this->spin_count = BARRIER_DEFAULT_SPIN_COUNT;
+            if (num_threads > available_cpus())
+                this->spin_count = BARRIER_OVERSUBSCRIBED_SPIN_COUNT;
+            char* env = getenv("BARRIER_SPIN_COUNT");
+            if (env != NULL)
+                this->spin_count = atoi(env);
+        }
+
+        for (size_t i = 0; i < flags.size(); ++i)
+        {
+            flags[i].count.store(0);
+            flags[i].sleeping.store(0);
+        }
+        for (int i = 0; i < num_threads; ++i)
+            episode[i].value = 0;
+    }
+
+    void wait(int thread_ID)
+    {
+        uint32_t target = ++episode[thread_ID].value;
+
+        for (int r = 0; r < num_rounds; ++r)
+        {
+            int partner = (thread_ID + (1 << r)) % num_threads;
+            signal(flags[partner * num_rounds + r], target);
+            wait_for(flags[thread_ID * num_rounds + r], target);
+        }
+    }
+
+    int get_spin_count() { return spin_count; }
+
+private:
+
+    struct alignas(CACHE_LINE_SIZE) Flag
+    {
+        std::atomic<uint32_t> count;
+        std::atomic<uint32_t> sleeping;
+    };
+
+    int num_threads, num_rounds, spin_count;
+    std::vector<Flag> flags;
+    std::vector<padded<uint32_t>> episode;
+
+    static int rounds(int num_threads)
+    {
+        int r = 0;
+        while ((1 << r) < num_threads)
+            r++;
+        return r;
+    }
+
+    // Only our partner writes our flag and it only ever moves forward, so
+    // "reached" is a wrap-around safe >=
+    static bool reached(uint32_t count, uint32_t target)
+    {
+        return (int32_t)(count - target) >= 0;
+    }
+
+    void signal(Flag& flag, uint32_t target)
+    {
+        // Both sides use sequentially consistent operations so that either
+        // the waiter sees the new count or we see that it is asleep
+        flag.count.store(target);
+        if (flag.sleeping.load())
+            futex_wake(&flag.count);
+    }
+
+    void wait_for(Flag& flag, uint32_t target)
+    {
+        for (int i = 0; i < spin_count; ++i)
+        {
+            if (reached(flag.count.load(std::memory_order_acquire), target))
+                return;
+            cpu_relax();
+        }
+
+        flag.sleeping.store(1);
+        uint32_t count = flag.count.load();
+        while (!reached(count, target))
+        {
+            futex_wait(&flag.count, count);
+            count = flag.count.load();
+        }
+        flag.sleeping.store(0);
+    }
+};
+
+#endif
@@ -0,0 +1,373 @@
+/*
+    Expression templates for fused elementwise array code.
+
+    Writing
+        y = exp(x) * cos(x) * sin(x) * sqrt(5.0 * x + 6.0);
+    with ordinary array classes makes a loop and a temporary array for every
+    operator.  Here the operators only build a small object describing the
+    expression, and assigning it to an Array runs a single loop
+        #pragma omp parallel for simd
+        for (i = ...) y[i] = exp(x[i]) * cos(x[i]) * ...;
+    in which everything is inlined, so the code is the same as the loop one
+    would write by hand.
+
+    Building blocks, all in namespace expr and found by argument dependent
+    lookup, so they can be used unqualified:
+        Array(n)              owns n doubles
+        Array(data, n)        wraps existing memory
+        a.range(begin, end)   assign to [begin, end) only
+        index()               the loop index i as a double
+        shift(a, s)           a[i + s], for stencils
+        + - * /, unary -      with arrays, expressions and doubles
+        abs, sqrt, exp, sin, cos
+        sum(e), max(e)        reductions over the size of the arrays in e,
+                              or sum(e, begin, end) and max(e, begin, end)
+    exp, sin and cos use the HA kernels of vmath.h, so they vectorize as part
+    of the fused loop; sin and cos give NaN for |x| >= 2^19.  As in vmath.h,
+    sqrt needs -fno-math-errno to vectorize.
+
+    shift(a, s) reads outside of a near its ends, so assign through range()
+    and reduce over a range when using it.  The array being assigned to must
+    not appear shifted on the right hand side (a Jacobi update needs the
+    old and new iterate in separate arrays anyway).
+
+    Called outside of a parallel region, assignments and reductions start
+    their own.  Inside one, an assignment is a worksharing loop that every
+    thread has to reach, while a reduction is computed by each thread on its
+    own.
+*/
+
+#ifndef EXPR_H
+#define EXPR_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include <math.h>
+
+// Vectorizable exp, sin and cos for a single point
+#include "vmath.h"
+
+// The element access of every node has to be inlined into the loop, else
+// the loop calls out and does not vectorize.  Deep expressions quickly go
+// beyond gcc's inlining limits, so force it.
+#ifdef __GNUC__
+#define EXPR_INLINE inline __attribute__((always_inline))
+#else
+#define EXPR_INLINE inline
+#endif
+
+namespace expr
+{
+    inline bool in_parallel()
+    {
+#ifdef _OPENMP
+        return omp_in_parallel();
+#else
+        return false;
+#endif
+    }
+
+    // Base of every expression, so that the operators below only ever match
+    // our own types
+    template <typename E>
+    struct Expr
+    {
+        const E& self() const { return static_cast<const E&>(*this); }
+    };
+
+    // Leaves and nodes are held by value and are just a few words each.  The
+    // size of an expression is that of the arrays in it, shifts and scalars
+    // have none.
+    struct Ref : Expr<Ref>
+    {
+        const double* data;
+        long int n;
+        Ref(const double* data, long int n) : data(data), n(n) {}
+        EXPR_INLINE double operator[](long int i) const { return data[i]; }
+        long int size() const { return n; }
+    };
+
+    struct Shift : Expr<Shift>
+    {
+        const double* data;
+        long int offset;
+        Shift(const double* data, long int offset) : data(data), offset(offset) {}
+        EXPR_INLINE double operator[](long int i) const { return data[i + offset]; }
+        long int size() const { return 0; }
+    };
+
+    struct Scalar : Expr<Scalar>
+    {
+        double value;
+        Scalar(double value) : value(value) {}
+        EXPR_INLINE double operator[](long int i) const { return value; }
+        long int size() const { return 0; }
+    };
+
+    struct Index : Expr<Index>
+    {
+        EXPR_INLINE double operator[](long int i) const { return (double)i; }
+        long int size() const { return 0; }
+    };
+
+    template <typename Op, typename A, typename B>
+    struct Binary : Expr<Binary<Op, A, B>>
+    {
+        A a;
+        B b;
+        Binary(const A& a, const B& b) : a(a), b(b) {}
+        EXPR_INLINE double operator[](long int i) const { return Op::apply(a[i], b[i]); }
+        long int size() const { return std::max(a.size(), b.size()); }
+    };
+
+    template <typename Op, typename A>
+    struct Unary : Expr<Unary<Op, A>>
+    {
+        A a;
+        Unary(const A& a) : a(a) {}
+        EXPR_INLINE double operator[](long int i) const { return Op::apply(a[i]); }
+        long int size() const { return a.size(); }
+    };
+
+    struct Add { EXPR_INLINE static double apply(double a, double b) { return a + b; } };
+    struct Subtract { EXPR_INLINE static double apply(double a, double b) { return a - b; } };
+    struct Multiply { EXPR_INLINE static double apply(double a, double b) { return a * b; } };
+    struct Divide { EXPR_INLINE static double apply(double a, double b) { return a / b; } };
+    struct Negate { EXPR_INLINE static double apply(double a) { return -a; } };
+    struct Abs { EXPR_INLINE static double apply(double a) { return fabs(a); } };
+    struct Sqrt { EXPR_INLINE static double apply(double a) { return sqrt(a); } };
+    struct Exp { EXPR_INLINE static double apply(double a) { return vmath_detail::exp_point<13>(a); } };
+
+    // NaN where the argument is too large for the reduction, as a bit mask
+    // so that it stays branch free
+    EXPR_INLINE double nan_unless_reducible(double x, double v)
+    {
+        int64_t bad = -(int64_t)!(fabs(x) < vmath_detail::MAX_REDUCE);
+        return vmath_detail::from_bits(vmath_detail::as_bits(v) | (bad & vmath_detail::as_bits(NAN)));
+    }
+
+    struct Sin
+    {
+        EXPR_INLINE static double apply(double a)
+        {
+            double s, c;
+            vmath_detail::sincos_point<VMATH_HA>(a, s, c);
+            return nan_unless_reducible(a, s);
+        }
+    };
+
+    struct Cos
+    {
+        EXPR_INLINE static double apply(double a)
+        {
+            double s, c;
+            vmath_detail::sincos_point<VMATH_HA>(a, s, c);
+            return nan_unless_reducible(a, c);
+        }
+    };
+
+    class Array;
+
+    // What an operand is stored as inside an expression: arrays by pointer,
+    // doubles as scalars, everything else as itself
+    template <typename E>
+    struct Leaf
+    {
+        typedef E type;
+        static const E& make(const E& e) { return e; }
+    };
+
+    template <>
+    struct Leaf<Array>
+    {
+        typedef Ref type;
+        static Ref make(const Array& a);
+    };
+
+    class Array : public Expr<Array>
+    {
+    public:
+
+        class Range
+        {
+        public:
+
+            Range(Array& array, long int begin, long int end) : array(array), begin(begin), end(end) {}
+
+            template <typename E>
+            Range& operator=(const Expr<E>& e)
+            {
+                array.assign(begin, end, Leaf<E>::make(e.self()));
+                return *this;
+            }
+
+            Range& operator=(double value)
+            {
+                array.assign(begin, end, Scalar(value));
+                return *this;
+            }
+
+        private:
+
+            Array& array;
+            long int begin, end;
+        };
+
+        Array(long int n) : storage(n), pointer(storage.data()), length(n) {}
+        Array(double* data, long int n) : pointer(data), length(n) {}
+
+        // Arrays are not copied implicitly, a = b copies the values
+        Array(const Array&) = delete;
+
+        Array& operator=(const Array& other)
+        {
+            assign(0, length, Ref(other.pointer, other.length));
+            return *this;
+        }
+
+        template <typename E>
+        Array& operator=(const Expr<E>& e)
+        {
+            assign(0, length, Leaf<E>::make(e.self()));
+            return *this;
+        }
+
+        Array& operator=(double value)
+        {
+            assign(0, length, Scalar(value));
+            return *this;
+        }
+
+        double& operator[](long int i) { return pointer[i]; }
+        EXPR_INLINE double operator[](long int i) const { return pointer[i]; }
+
+        long int size() const { return length; }
+        double* data() { return pointer; }
+        const double* data() const { return pointer; }
+
+        Range range(long int begin, long int end) { return Range(*this, begin, end); }
+
+        // Exchange contents, e.g. old and new iterate
+        friend void swap(Array& a, Array& b)
+        {
+            std::swap(a.storage, b.storage);
+            std::swap(a.pointer, b.pointer);
+            std::swap(a.length, b.length);
+        }
+
+    private:
+
+        std::vector<double> storage;
+        double* pointer;
+        long int length;
+
+        // The one loop every assignment turns into
+        template <typename E>
+        void assign(long int begin, long int end, const E& e)
+        {
+            double* destination = pointer;
+            if (in_parallel())
+            {
+                #pragma omp for simd schedule(static)
+                for (long int i = begin; i < end; ++i)
+                    destination[i] = e[i];
+            }
+            else
+            {
+                #pragma omp parallel for simd schedule(static)
+                for (long int i = begin; i < end; ++i)
+                    destination[i] = e[i];
+            }
+        }
+    };
+
+    inline Ref Leaf<Array>::make(const Array& a) { return Ref(a.data(), a.size()); }
+
+    inline Index index() { return Index(); }
+
+    inline Shift shift(const Array& a, long int offset) { return Shift(a.data(), offset); }
+
+    // Operators for every combination of expressions and doubles
+#define EXPR_BINARY_OPERATOR(SYMBOL, OP)                                                            \
+    template <typename A, typename B>                                                               \
+    inline Binary<OP, typename Leaf<A>::type, typename Leaf<B>::type>                               \
+    operator SYMBOL(const Expr<A>& a, const Expr<B>& b)                                             \
+    {                                                                                               \
+        return Binary<OP, typename Leaf<A>::type, typename Leaf<B>::type>(Leaf<A>::make(a.self()),  \
+                                                                          Leaf<B>::make(b.self())); \
+    }                                                                                               \
+    template <typename A>                                                                           \
+    inline Binary<OP, typename Leaf<A>::type, Scalar> operator SYMBOL(const Expr<A>& a, double b)   \
+    {                                                                                               \
+        return Binary<OP, typename Leaf<A>::type, Scalar>(Leaf<A>::make(a.self()), Scalar(b));      \
+    }                                                                                               \
+    template <typename B>                                                                           \
+    inline Binary<OP, Scalar, typename Leaf<B>::type> operator SYMBOL(double a, const Expr<B>& b)   \
+    {                                                                                               \
+        return Binary<OP, Scalar, typename Leaf<B>::type>(Scalar(a), Leaf<B>::make(b.self()));      \
+    }
+
+    EXPR_BINARY_OPERATOR(+, Add)
+    EXPR_BINARY_OPERATOR(-, Subtract)
+    EXPR_BINARY_OPERATOR(*, Multiply)
+    EXPR_BINARY_OPERATOR(/, Divide)
+#undef EXPR_BINARY_OPERATOR
+
+#define EXPR_UNARY_FUNCTION(NAME, OP)                                              \
+    template <typename A>                                                          \
+    inline Unary<OP, typename Leaf<A>::type> NAME(const Expr<A>& a)                \
+    {                                                                              \
+        return Unary<OP, typename Leaf<A>::type>(Leaf<A>::make(a.self()));         \
+    }
+
+    EXPR_UNARY_FUNCTION(operator-, Negate)
+    EXPR_UNARY_FUNCTION(abs, Abs)
+    EXPR_UNARY_FUNCTION(sqrt, Sqrt)
+    EXPR_UNARY_FUNCTION(exp, Exp)
+    EXPR_UNARY_FUNCTION(sin, Sin)
+    EXPR_UNARY_FUNCTION(cos, Cos)
+#undef EXPR_UNARY_FUNCTION
+
+    // Reductions over [begin, end), one fused loop like the assignments
+    template <typename A>
+    inline double sum(const Expr<A>& a, long int begin, long int end)
+    {
+        typename Leaf<A>::type e = Leaf<A>::make(a.self());
+        double total = 0.0;
+        #pragma omp parallel for simd schedule(static) reduction(+ : total) if (!in_parallel())
+        for (long int i = begin; i < end; ++i)
+            total += e[i];
+        return total;
+    }
+
+    template <typename A>
+    inline double max(const Expr<A>& a, long int begin, long int end)
+    {
+        typename Leaf<A>::type e = Leaf<A>::make(a.self());
+        double maximum = -INFINITY;
+        #pragma omp parallel for simd schedule(static) reduction(max : maximum) if (!in_parallel())
+        for (long int i = begin; i < end; ++i)
+            maximum = (e[i] > maximum) ? e[i] : maximum;
+        return maximum;
+    }
+
+    // Over the whole size of the expression
+    template <typename A>
+    inline double sum(const Expr<A>& a)
+    {
+        return sum(a, 0, Leaf<A>::make(a.self()).size());
+    }
+
+    template <typename A>
+    inline double max(const Expr<A>& a)
+    {
+        return max(a, 0, Leaf<A>::make(a.self()).size());
+    }
+}
+
+#endif
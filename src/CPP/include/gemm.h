@@ -0,0 +1,269 @@
+/*
+    Cache-blocked matrix multiply, C = alpha A B + beta C, for row-major
+    A (M x K), B (K x N) and C (M x N).
+
+    The loops follow Goto and van de Geijn ("Anatomy of high-performance
+    matrix multiplication", 2008), as in BLIS:
+        for jc in steps of NC       columns of B and C, NC x KC of B in L3
+          for pc in steps of KC     pack B(pc:pc+KC, jc:jc+NC)
+            for ic in steps of MC   pack A(ic:ic+MC, pc:pc+KC), fits in L2
+              for jr in steps of NR     KC x NR strip of B stays in L1
+                for ir in steps of MR   micro-kernel: MR x NR block of C in
+                                        registers, KC rank-1 updates
+    Packing copies the blocks into the order in which the micro-kernel reads
+    them, so that it streams through contiguous memory with unit stride and
+    no TLB misses, and pads partial blocks with zeros.
+
+    The micro-kernel keeps MR x NR accumulators in vector registers and does
+    one FMA per register for every k:
+        AVX-512     MR = 12, NR = 16    24 of the 32 zmm registers
+        AVX2 + FMA  MR = 6,  NR = 8     12 of the 16 ymm registers
+        otherwise   MR = 4,  NR = 4     scalar code
+    Build with -march=native to get the widest one.
+
+    With OpenMP the threads share the packed B panel, pack it together and
+    then take MC row blocks of A each with a packed copy of their own.  When
+    there are fewer row blocks than threads, the NR strips of the panel (the
+    jr loop) are split as well, as BLIS does, so that every thread gets a
+    row block and a range of strips; threads that share a row block each pack
+    it.  Call gemm() from outside of a parallel region.
+*/
+
+#ifndef GEMM_H
+#define GEMM_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include <stdint.h>
+
+#if defined(__AVX512F__) || (defined(__AVX2__) && defined(__FMA__))
+#include <immintrin.h>
+#endif
+
+namespace gemm_detail
+{
+#if defined(__AVX512F__)
+    int const MR = 12, NR = 16;
+#elif defined(__AVX2__) && defined(__FMA__)
+    int const MR = 6, NR = 8;
+#else
+    int const MR = 4, NR = 4;
+#endif
+
+    // KC x NR of B in L1, MC x KC of A in L2, KC x NC of B in L3
+    int const KC = 256;
+    int const MC = 16 * MR;
+    int const NC = 256 * NR;
+
+    // Rows ic, ..., ic + mc - 1 and columns pc, ..., pc + kc - 1 of A as
+    // strips of MR rows, column by column within a strip
+    inline void pack_a(int mc, int kc, const double* A, int lda, double* packed)
+    {
+        for (int ir = 0; ir < mc; ir += MR)
+        {
+            int m = std::min(MR, mc - ir);
+            for (int k = 0; k < kc; ++k)
+            {
+                for (int i = 0; i < m; ++i)
+                    packed[k * MR + i] = A[(ir + i) * lda + k];
+                for (int i = m; i < MR; ++i)
+                    packed[k * MR + i] = 0.0;
+            }
+            packed += MR * kc;
+        }
+    }
+
+    // One strip of NR columns of a kc x nc block of B, row by row
+    inline void pack_b_strip(int kc, int n, const double* B, int ldb, double* packed)
+    {
+        for (int k = 0; k < kc; ++k)
+        {
+            for (int j = 0; j < n; ++j)
+                packed[k * NR + j] = B[k * ldb + j];
+            for (int j = n; j < NR; ++j)
+                packed[k * NR + j] = 0.0;
+        }
+    }
+
+    // First 64 byte boundary in a buffer with 7 doubles to spare, so that
+    // vector loads from the packed blocks do not straddle cache lines
+    inline double* align(std::vector<double>& buffer)
+    {
+        return (double*)(((uintptr_t)buffer.data() + 63) & ~(uintptr_t)63);
+    }
+
+    // C(0:m, 0:n) += alpha a b for an MR x kc strip a and a kc x NR strip b
+    inline void micro_kernel(int kc, const double* a, const double* b, double* C, int ldc, double alpha, int m, int n)
+    {
+        double tile[MR * NR];
+
+#if defined(__AVX512F__)
+        __m512d acc[MR][2];
+        for (int i = 0; i < MR; ++i)
+            acc[i][0] = acc[i][1] = _mm512_setzero_pd();
+        for (int k = 0; k < kc; ++k)
+        {
+            __m512d b0 = _mm512_loadu_pd(b), b1 = _mm512_loadu_pd(b + 8);
+            for (int i = 0; i < MR; ++i)
+            {
+                __m512d ai = _mm512_set1_pd(a[i]);
+                acc[i][0] = _mm512_fmadd_pd(ai, b0, acc[i][0]);
+                acc[i][1] = _mm512_fmadd_pd(ai, b1, acc[i][1]);
+            }
+            a += MR;
+            b += NR;
+        }
+
+        __m512d scale = _mm512_set1_pd(alpha);
+        if (m == MR && n == NR)
+        {
+            for (int i = 0; i < MR; ++i)
+            {
+                double* row = C + i * ldc;
+                _mm512_storeu_pd(row, _mm512_fmadd_pd(scale, acc[i][0], _mm512_loadu_pd(row)));
+                _mm512_storeu_pd(row + 8, _mm512_fmadd_pd(scale, acc[i][1], _mm512_loadu_pd(row + 8)));
+            }
+            return;
+        }
+        for (int i = 0; i < MR; ++i)
+        {
+            _mm512_storeu_pd(tile + i * NR, acc[i][0]);
+            _mm512_storeu_pd(tile + i * NR + 8, acc[i][1]);
+        }
+#elif defined(__AVX2__) && defined(__FMA__)
+        __m256d acc[MR][2];
+        for (int i = 0; i < MR; ++i)
+            acc[i][0] = acc[i][1] = _mm256_setzero_pd();
+        for (int k = 0; k < kc; ++k)
+        {
+            __m256d b0 = _mm256_loadu_pd(b), b1 = _mm256_loadu_pd(b + 4);
+            for (int i = 0; i < MR; ++i)
+            {
+                __m256d ai = _mm256_broadcast_sd(a + i);
+                acc[i][0] = _mm256_fmadd_pd(ai, b0, acc[i][0]);
+                acc[i][1] = _mm256_fmadd_pd(ai, b1, acc[i][1]);
+            }
+            a += MR;
+            b += NR;
+        }
+
+        __m256d scale = _mm256_set1_pd(alpha);
+        if (m == MR && n == NR)
+        {
+            for (int i = 0; i < MR; ++i)
+            {
+                double* row = C + i * ldc;
+                _mm256_storeu_pd(row, _mm256_fmadd_pd(scale, acc[i][0], _mm256_loadu_pd(row)));
+                _mm256_storeu_pd(row + 4, _mm256_fmadd_pd(scale, acc[i][1], _mm256_loadu_pd(row + 4)));
+            }
+            return;
+        }
+        for (int i = 0; i < MR; ++i)
+        {
+            _mm256_storeu_pd(tile + i * NR, acc[i][0]);
+            _mm256_storeu_pd(tile + i * NR + 4, acc[i][1]);
+        }
+#else
+        for (int i = 0; i < MR * NR; ++i)
+            tile[i] = 0.0;
+        for (int k = 0; k < kc; ++k)
+        {
+            for (int i = 0; i < MR; ++i)
+                for (int j = 0; j < NR; ++j)
+                    tile[i * NR + j] += a[i] * b[j];
+            a += MR;
+            b += NR;
+        }
+#endif
+
+        // Partial block at the edge of C
+        for (int i = 0; i < m; ++i)
+            for (int j = 0; j < n; ++j)
+                C[i * ldc + j] += alpha * tile[i * NR + j];
+    }
+}
+
+inline void gemm(int M, int N, int K, double alpha, const double* A, int lda, const double* B, int ldb,
+                 double beta, double* C, int ldc)
+{
+    using namespace gemm_detail;
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < M; ++i)
+    {
+        double* row = C + (size_t)i * ldc;
+        for (int j = 0; j < N; ++j)
+            row[j] = (beta == 0.0) ? 0.0 : beta * row[j];
+    }
+    if (alpha == 0.0 || K == 0)
+        return;
+
+    // Only as large as needed, small products should not pay for zeroing
+    // megabytes
+    int b_rows = std::min(KC, K), b_columns = std::min(NC, (N + NR - 1) / NR * NR);
+    std::vector<double> packed_b_buffer((size_t)b_rows * b_columns + 7);
+    double* packed_b = align(packed_b_buffer);
+
+    #pragma omp parallel
+    {
+        std::vector<double> packed_a_buffer((size_t)std::min(MC, (M + MR - 1) / MR * MR) * b_rows + 7);
+        double* packed_a = align(packed_a_buffer);
+
+        // Work items are a row block and one of jr_ways ranges of strips
+        int num_threads = 1;
+#ifdef _OPENMP
+        num_threads = omp_get_num_threads();
+#endif
+        int ic_blocks = (M + MC - 1) / MC;
+        int jr_ways = std::max(1, std::min((num_threads + ic_blocks - 1) / ic_blocks, (std::min(NC, N) + NR - 1) / NR));
+
+        for (int jc = 0; jc < N; jc += NC)
+        {
+            int nc = std::min(NC, N - jc);
+            for (int pc = 0; pc < K; pc += KC)
+            {
+                int kc = std::min(KC, K - pc);
+
+                // Everyone packs some strips of B, the barrier at the end of
+                // the loop makes the whole panel visible
+                #pragma omp for schedule(static)
+                for (int jr = 0; jr < nc; jr += NR)
+                    pack_b_strip(kc, std::min(NR, nc - jr), B + (size_t)pc * ldb + jc + jr, ldb,
+                                 packed_b + (size_t)jr * kc);
+
+                // and the next panel is only packed once all items are done.
+                // A thread that gets consecutive items of the same row block
+                // packs it once.
+                int strips = (nc + NR - 1) / NR, packed_ic = -1;
+                #pragma omp for schedule(static)
+                for (int item = 0; item < ic_blocks * jr_ways; ++item)
+                {
+                    int ic = item / jr_ways * MC, way = item % jr_ways;
+                    int mc = std::min(MC, M - ic);
+                    int jr_begin = (int)((long)strips * way / jr_ways) * NR;
+                    int jr_end = std::min(nc, (int)((long)strips * (way + 1) / jr_ways) * NR);
+                    if (jr_begin >= jr_end)
+                        continue;
+                    if (ic != packed_ic)
+                    {
+                        pack_a(mc, kc, A + (size_t)ic * lda + pc, lda, packed_a);
+                        packed_ic = ic;
+                    }
+
+                    for (int jr = jr_begin; jr < jr_end; jr += NR)
+                        for (int ir = 0; ir < mc; ir += MR)
+                            micro_kernel(kc, packed_a + (size_t)ir * kc, packed_b + (size_t)jr * kc,
+                                         C + (size_t)(ic + ir) * ldc + jc + jr, ldc, alpha,
+                                         std::min(MR, mc - ir), std::min(NR, nc - jr));
+                }
+            }
+        }
+    }
+}
+
+#endif
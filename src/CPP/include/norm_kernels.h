@@ -0,0 +1,176 @@
+/*
+    Streaming kernels for the vector normalization of fine_grain/coarse_grain.
+
+    The demos make three passes over memory: sum |x_i|, then y_i = x_i / norm,
+    then sum |y_i|.  For vectors much larger than the caches each pass costs a
+    full trip to DRAM, so here
+        l1_norm           reads x once, and
+        normalize         reads x, writes y and sums |y_i| in the same pass.
+    normalize writes y with non-temporal (streaming) stores when AVX or SSE2
+    is available, so y does not have to be read into the cache before it is
+    overwritten and does not evict x on its way out.  The streaming stores
+    need aligned addresses, so each call handles a short scalar prologue and
+    epilogue around the vector loop.
+
+    Both kernels work on [begin, end) so they can be called from inside an
+    existing parallel region on a thread's own slice; call stream_fence()
+    before anyone reads y written with streaming stores.
+
+    OnlineNormalizer does the same for data that arrives in chunks and is
+    never held in memory all at once: feed every chunk to accumulate(), then
+    feed them again to normalize().  Each call splits its chunk over the
+    OpenMP threads, so it must be called from outside a parallel region.
+*/
+
+#ifndef NORM_KERNELS_H
+#define NORM_KERNELS_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdint.h>
+
+#include <math.h>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// sum |x_i| over [begin, end)
+inline double l1_norm(const double* x, long int begin, long int end)
+{
+    double sum = 0.0;
+    #pragma omp simd reduction(+ : sum)
+    for (long int i = begin; i < end; ++i)
+        sum += fabs(x[i]);
+    return sum;
+}
+
+// y_i = x_i / norm over [begin, end), returns sum |y_i|
+inline double normalize(const double* x, double* y, long int begin, long int end, double norm)
+{
+    double sum = 0.0;
+    long int i = begin;
+
+#if defined(__AVX__)
+    // Scalar until y is 32 byte aligned
+    for (; i < end && ((uintptr_t)&y[i] & 31) != 0; ++i)
+    {
+        y[i] = x[i] / norm;
+        sum += fabs(y[i]);
+    }
+
+    __m256d vector_norm = _mm256_set1_pd(norm);
+    __m256d abs_mask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    __m256d vector_sum_0 = _mm256_setzero_pd(), vector_sum_1 = _mm256_setzero_pd();
+    for (; i + 8 <= end; i += 8)
+    {
+        __m256d y_0 = _mm256_div_pd(_mm256_loadu_pd(&x[i]), vector_norm);
+        __m256d y_1 = _mm256_div_pd(_mm256_loadu_pd(&x[i + 4]), vector_norm);
+        _mm256_stream_pd(&y[i], y_0);
+        _mm256_stream_pd(&y[i + 4], y_1);
+        vector_sum_0 = _mm256_add_pd(vector_sum_0, _mm256_and_pd(y_0, abs_mask));
+        vector_sum_1 = _mm256_add_pd(vector_sum_1, _mm256_and_pd(y_1, abs_mask));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(vector_sum_0, vector_sum_1));
+    sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#elif defined(__SSE2__)
+    // Scalar until y is 16 byte aligned
+    for (; i < end && ((uintptr_t)&y[i] & 15) != 0; ++i)
+    {
+        y[i] = x[i] / norm;
+        sum += fabs(y[i]);
+    }
+
+    __m128d vector_norm = _mm_set1_pd(norm);
+    __m128d abs_mask = _mm_castsi128_pd(_mm_set1_epi64x(0x7fffffffffffffffLL));
+    __m128d vector_sum = _mm_setzero_pd();
+    for (; i + 2 <= end; i += 2)
+    {
+        __m128d y_0 = _mm_div_pd(_mm_loadu_pd(&x[i]), vector_norm);
+        _mm_stream_pd(&y[i], y_0);
+        vector_sum = _mm_add_pd(vector_sum, _mm_and_pd(y_0, abs_mask));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, vector_sum);
+    sum += lanes[0] + lanes[1];
+#endif
+
+    // Whatever is left (everything without SSE2)
+    for (; i < end; ++i)
+    {
+        y[i] = x[i] / norm;
+        sum += fabs(y[i]);
+    }
+    return sum;
+}
+
+// Make streaming stores visible to other threads
+inline void stream_fence()
+{
+#if defined(__AVX__) || defined(__SSE2__)
+    _mm_sfence();
+#endif
+}
+
+// This thread's contiguous share of [0, length)
+inline void thread_slice(long int length, long int& begin, long int& end)
+{
+    int thread_ID = 0, num_threads = 1;
+#ifdef _OPENMP
+    thread_ID = omp_get_thread_num();
+    num_threads = omp_get_num_threads();
+#endif
+    long int points_per_thread = (length + num_threads - 1) / num_threads;
+    begin = thread_ID * points_per_thread;
+    end = begin + points_per_thread;
+    if (begin > length)
+        begin = length;
+    if (end > length)
+        end = length;
+}
+
+class OnlineNormalizer
+{
+public:
+
+    OnlineNormalizer() : norm(0.0), y_norm(0.0) {}
+
+    // First pass, once per chunk
+    void accumulate(const double* chunk, long int length)
+    {
+        double sum = 0.0;
+        #pragma omp parallel reduction(+ : sum)
+        {
+            long int begin, end;
+            thread_slice(length, begin, end);
+            sum += l1_norm(chunk, begin, end);
+        }
+        norm += sum;
+    }
+
+    // Second pass, once per chunk in any order, writes the normalized chunk
+    void normalize(const double* chunk, double* result, long int length)
+    {
+        double sum = 0.0;
+        #pragma omp parallel reduction(+ : sum)
+        {
+            long int begin, end;
+            thread_slice(length, begin, end);
+            sum += ::normalize(chunk, result, begin, end, norm);
+            stream_fence();
+        }
+        y_norm += sum;
+    }
+
+    double get_norm() { return norm; }
+    double get_y_norm() { return y_norm; }
+
+private:
+
+    double norm, y_norm;
+};
+
+#endif
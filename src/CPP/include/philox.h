@@ -0,0 +1,150 @@
+/*
+    Philox4x32-10 counter-based random numbers (Salmon et al., "Parallel
+    random numbers: as easy as 1, 2, 3", SC11).
+
+    Instead of a state that is advanced one step at a time, Philox is a keyed
+    bijection of a 128 bit counter: 10 rounds of 32 x 32 -> 64 bit multiplies
+    and xors turn (counter, key) into 4 random 32 bit words.  Any number in
+    the sequence can therefore be computed directly from its position, which
+    gives
+        - streams: the seed is the key and the stream number the upper half
+          of the counter, so every (seed, stream) pair is an independent
+          sequence of 2^64 blocks,
+        - skipping ahead for free, and
+        - results that do not depend on how the work is split: sample i
+          always uses the numbers at position i, whichever rank or thread
+          computes it.
+    Every rank and thread can share stream 0 and take the positions of the
+    samples it was given, or use a stream of its own.
+
+    philox_uniform() fills an array with doubles in [0, 1), position k of the
+    stream being the 53 bit double made from words 2 (k % 2) and
+    2 (k % 2) + 1 of block k / 2.  Its loop over blocks has no branches and
+    vectorizes (the 32 bit multiplies map to vpmuludq), build with
+    -march=native.
+
+    The header is plain C99 so that the C demos can use it too.  C++ gets the
+    PhiloxStream class at the end.
+*/
+
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <stdint.h>
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+typedef struct { uint32_t v[4]; } philox4x32_ctr_t;
+typedef struct { uint32_t v[2]; } philox4x32_key_t;
+
+/* The 10 rounds on (c0, c1, c2, c3) with key (k0, k1), in place */
+static inline void philox4x32_10(uint32_t* c0, uint32_t* c1, uint32_t* c2, uint32_t* c3,
+                                 uint32_t k0, uint32_t k1)
+{
+    int round;
+    for (round = 0; round < 10; ++round)
+    {
+        uint64_t p0 = (uint64_t)PHILOX_M0 * *c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1 * *c2;
+        uint32_t n0 = (uint32_t)(p1 >> 32) ^ *c1 ^ k0;
+        uint32_t n2 = (uint32_t)(p0 >> 32) ^ *c3 ^ k1;
+        *c1 = (uint32_t)p1;
+        *c3 = (uint32_t)p0;
+        *c0 = n0;
+        *c2 = n2;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+static inline philox4x32_ctr_t philox4x32(philox4x32_ctr_t ctr, philox4x32_key_t key)
+{
+    philox4x32_10(&ctr.v[0], &ctr.v[1], &ctr.v[2], &ctr.v[3], key.v[0], key.v[1]);
+    return ctr;
+}
+
+/* 53 random bits from two words, as a double in [0, 1) */
+static inline double philox_to_double(uint32_t high, uint32_t low)
+{
+    return (double)((((uint64_t)high << 32) | low) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Block number block of (seed, stream) */
+static inline philox4x32_ctr_t philox_block(uint64_t seed, uint64_t stream, uint64_t block)
+{
+    philox4x32_ctr_t ctr = {{(uint32_t)block, (uint32_t)(block >> 32), (uint32_t)stream, (uint32_t)(stream >> 32)}};
+    philox4x32_key_t key = {{(uint32_t)seed, (uint32_t)(seed >> 32)}};
+    return philox4x32(ctr, key);
+}
+
+/* The double at a single position of (seed, stream) */
+static inline double philox_double(uint64_t seed, uint64_t stream, uint64_t position)
+{
+    philox4x32_ctr_t r = philox_block(seed, stream, position / 2);
+    return (position % 2 == 0) ? philox_to_double(r.v[0], r.v[1]) : philox_to_double(r.v[2], r.v[3]);
+}
+
+/* out[k] = the double at position first + k of (seed, stream), k < n */
+static inline void philox_uniform(uint64_t seed, uint64_t stream, uint64_t first, long int n, double* out)
+{
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+    uint32_t s0 = (uint32_t)stream, s1 = (uint32_t)(stream >> 32);
+    long int j, num_blocks;
+
+    /* Odd start, the second half of a block by itself */
+    if (n > 0 && first % 2 == 1)
+    {
+        *out++ = philox_double(seed, stream, first++);
+        n--;
+    }
+
+    num_blocks = n / 2;
+    #pragma omp simd
+    for (j = 0; j < num_blocks; ++j)
+    {
+        uint64_t block = first / 2 + j;
+        uint32_t c0 = (uint32_t)block, c1 = (uint32_t)(block >> 32), c2 = s0, c3 = s1;
+        philox4x32_10(&c0, &c1, &c2, &c3, k0, k1);
+        out[2 * j] = philox_to_double(c0, c1);
+        out[2 * j + 1] = philox_to_double(c2, c3);
+    }
+
+    if (n % 2 == 1)
+        out[n - 1] = philox_double(seed, stream, first + n - 1);
+}
+
+#ifdef __cplusplus
+
+// One stream as an object that remembers its position, for code that wants
+// numbers one at a time
+class PhiloxStream
+{
+public:
+
+    PhiloxStream(uint64_t seed, uint64_t stream = 0, uint64_t position = 0)
+        : seed(seed), stream(stream), next(position) {}
+
+    double uniform() { return philox_double(seed, stream, next++); }
+
+    // The next n numbers, vectorized
+    void uniform(double* out, long int n)
+    {
+        philox_uniform(seed, stream, next, n, out);
+        next += n;
+    }
+
+    void skip(uint64_t n) { next += n; }
+    void seek(uint64_t position) { next = position; }
+    uint64_t position() const { return next; }
+
+private:
+
+    uint64_t seed, stream, next;
+};
+
+#endif
+
+#endif
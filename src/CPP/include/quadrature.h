@@ -0,0 +1,233 @@
+/*
+    Composite quadrature rules as vectorized, threaded kernels.
+
+    [a, b] is cut into n panels of width h = (b - a) / n and every panel is
+    integrated with the same rule, given as nodes t_j in [0, 1] and weights
+    w_j adding up to 1:
+        QUAD_MIDPOINT     1 node, error O(h^2)
+        QUAD_SIMPSON      2 nodes per panel (the right end point is the next
+                          panel's left one), error O(h^4)
+        QUAD_GAUSS2 ... QUAD_GAUSS5
+                          Gauss-Legendre with 2 to 5 nodes, error O(h^4) to
+                          O(h^10)
+    The kernels only sum the panels [first, last), so ranks and threads can
+    split n panels any way they like:
+        h * (sum over all panels + quadrature_end_correction(...))
+    is the composite rule.  Panel i has its nodes at a + (i + t_j) h, with i
+    a 64 bit integer, so n can go far beyond 2^31.
+
+    For smooth integrands the error of all of these is a series in even
+    powers of h, so estimates with n, 2n, 4n, ... panels can be combined by
+    Richardson extrapolation, richardson() below.
+
+    The integrand is a function object whose operator() the compiler can
+    inline, written without branches so that the loop over panels
+    vectorizes.
+*/
+
+#ifndef QUADRATURE_H
+#define QUADRATURE_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stdint.h>
+
+#include <math.h>
+
+enum { QUAD_MIDPOINT, QUAD_SIMPSON, QUAD_GAUSS2, QUAD_GAUSS3, QUAD_GAUSS4, QUAD_GAUSS5 };
+
+namespace quadrature_detail
+{
+    // Nodes in [0, 1] and weights summing to 1 of one panel, end_weight() is
+    // what f(b) - f(a) gets on top of the panel sums
+    template <int RULE>
+    struct Rule;
+
+    template <>
+    struct Rule<QUAD_MIDPOINT>
+    {
+        static const int NODES = 1, ORDER = 2;
+        static double node(int j) { return 0.5; }
+        static double weight(int j) { return 1.0; }
+        static double end_weight() { return 0.0; }
+    };
+
+    // (f(x_i) + 4 f(x_i + h / 2) + f(x_i + h)) / 6 with the right end point
+    // counted as the left one of the next panel
+    template <>
+    struct Rule<QUAD_SIMPSON>
+    {
+        static const int NODES = 2, ORDER = 4;
+        static double node(int j) { return (j == 0) ? 0.0 : 0.5; }
+        static double weight(int j) { return (j == 0) ? 1.0 / 3.0 : 2.0 / 3.0; }
+        static double end_weight() { return 1.0 / 6.0; }
+    };
+
+    // Gauss-Legendre nodes and weights on [-1, 1] for 2 to 5 nodes
+    double const GAUSS_X[4][5] = {
+        {-0.57735026918962576451, 0.57735026918962576451},
+        {-0.77459666924148337704, 0.0, 0.77459666924148337704},
+        {-0.86113631159405257522, -0.33998104358485626480, 0.33998104358485626480, 0.86113631159405257522},
+        {-0.90617984593866399280, -0.53846931010568309104, 0.0, 0.53846931010568309104,
+         0.90617984593866399280}};
+    double const GAUSS_W[4][5] = {
+        {1.0, 1.0},
+        {0.55555555555555555556, 0.88888888888888888889, 0.55555555555555555556},
+        {0.34785484513745385737, 0.65214515486254614263, 0.65214515486254614263, 0.34785484513745385737},
+        {0.23692688505618908751, 0.47862867049936646804, 0.56888888888888888889, 0.47862867049936646804,
+         0.23692688505618908751}};
+
+    // Mapped from [-1, 1] to [0, 1]
+    template <int N>
+    struct Gauss
+    {
+        static const int NODES = N, ORDER = 2 * N;
+        static double node(int j) { return 0.5 * (1.0 + GAUSS_X[N - 2][j]); }
+        static double weight(int j) { return 0.5 * GAUSS_W[N - 2][j]; }
+        static double end_weight() { return 0.0; }
+    };
+
+    template <>
+    struct Rule<QUAD_GAUSS2> : Gauss<2> {};
+    template <>
+    struct Rule<QUAD_GAUSS3> : Gauss<3> {};
+    template <>
+    struct Rule<QUAD_GAUSS4> : Gauss<4> {};
+    template <>
+    struct Rule<QUAD_GAUSS5> : Gauss<5> {};
+
+    // Weighted sum over the nodes of panel i, the node loop has a constant
+    // trip count and is unrolled
+    template <int RULE, typename F>
+    inline double panel(const F& f, double a, double h, int64_t i, const double* t, const double* w)
+    {
+        double x = a + (double)i * h;
+        double s = 0.0;
+        for (int j = 0; j < Rule<RULE>::NODES; ++j)
+            s += w[j] * f(x + t[j] * h);
+        return s;
+    }
+
+    template <int RULE, typename F>
+    inline double sum_kernel(const F& f, double a, double h, int64_t first, int64_t last, int num_threads)
+    {
+        typedef Rule<RULE> R;
+        double t[R::NODES], w[R::NODES];
+        for (int j = 0; j < R::NODES; ++j)
+        {
+            t[j] = R::node(j);
+            w[j] = R::weight(j);
+        }
+
+        double sum = 0.0;
+        #pragma omp parallel for simd schedule(static) reduction(+ : sum) num_threads(num_threads)
+        for (int64_t i = first; i < last; ++i)
+            sum += panel<RULE>(f, a, h, i, t, w);
+        return sum;
+    }
+
+    template <int RULE, typename F>
+    inline void terms_kernel(const F& f, double a, double h, int64_t first, long int count, double* terms)
+    {
+        typedef Rule<RULE> R;
+        double t[R::NODES], w[R::NODES];
+        for (int j = 0; j < R::NODES; ++j)
+        {
+            t[j] = R::node(j);
+            w[j] = R::weight(j);
+        }
+
+        #pragma omp simd
+        for (long int k = 0; k < count; ++k)
+            terms[k] = panel<RULE>(f, a, h, first + k, t, w);
+    }
+}
+
+// Error order p of a rule, the error goes like h^p
+inline int quadrature_order(int rule)
+{
+    using namespace quadrature_detail;
+    int const orders[] = {Rule<QUAD_MIDPOINT>::ORDER, Rule<QUAD_SIMPSON>::ORDER, Rule<QUAD_GAUSS2>::ORDER,
+                          Rule<QUAD_GAUSS3>::ORDER, Rule<QUAD_GAUSS4>::ORDER, Rule<QUAD_GAUSS5>::ORDER};
+    return orders[rule];
+}
+
+// Integrand evaluations per panel
+inline int quadrature_nodes(int rule)
+{
+    using namespace quadrature_detail;
+    int const nodes[] = {Rule<QUAD_MIDPOINT>::NODES, Rule<QUAD_SIMPSON>::NODES, Rule<QUAD_GAUSS2>::NODES,
+                         Rule<QUAD_GAUSS3>::NODES, Rule<QUAD_GAUSS4>::NODES, Rule<QUAD_GAUSS5>::NODES};
+    return nodes[rule];
+}
+
+// Sum over the panels [first, last) of width h starting at a, split over
+// num_threads OpenMP threads (0 for the default).  Not scaled by h.
+template <typename F>
+double quadrature_sum(const F& f, int rule, double a, double h, int64_t first, int64_t last, int num_threads = 0)
+{
+    using namespace quadrature_detail;
+
+#ifdef _OPENMP
+    if (num_threads <= 0)
+        num_threads = omp_get_max_threads();
+#else
+    num_threads = 1;
+#endif
+
+    switch (rule)
+    {
+        case QUAD_MIDPOINT: return sum_kernel<QUAD_MIDPOINT>(f, a, h, first, last, num_threads);
+        case QUAD_SIMPSON: return sum_kernel<QUAD_SIMPSON>(f, a, h, first, last, num_threads);
+        case QUAD_GAUSS2: return sum_kernel<QUAD_GAUSS2>(f, a, h, first, last, num_threads);
+        case QUAD_GAUSS3: return sum_kernel<QUAD_GAUSS3>(f, a, h, first, last, num_threads);
+        case QUAD_GAUSS4: return sum_kernel<QUAD_GAUSS4>(f, a, h, first, last, num_threads);
+        default: return sum_kernel<QUAD_GAUSS5>(f, a, h, first, last, num_threads);
+    }
+}
+
+// The contribution of each of the panels first, ..., first + count - 1 in
+// terms, for summing them some other way.  Serial, for use by one thread.
+template <typename F>
+void quadrature_terms(const F& f, int rule, double a, double h, int64_t first, long int count, double* terms)
+{
+    using namespace quadrature_detail;
+
+    switch (rule)
+    {
+        case QUAD_MIDPOINT: terms_kernel<QUAD_MIDPOINT>(f, a, h, first, count, terms); break;
+        case QUAD_SIMPSON: terms_kernel<QUAD_SIMPSON>(f, a, h, first, count, terms); break;
+        case QUAD_GAUSS2: terms_kernel<QUAD_GAUSS2>(f, a, h, first, count, terms); break;
+        case QUAD_GAUSS3: terms_kernel<QUAD_GAUSS3>(f, a, h, first, count, terms); break;
+        case QUAD_GAUSS4: terms_kernel<QUAD_GAUSS4>(f, a, h, first, count, terms); break;
+        default: terms_kernel<QUAD_GAUSS5>(f, a, h, first, count, terms); break;
+    }
+}
+
+// Added once to the sum over all panels, nonzero for rules that share end
+// points between panels
+template <typename F>
+double quadrature_end_correction(const F& f, int rule, double a, double b)
+{
+    using namespace quadrature_detail;
+    return (rule == QUAD_SIMPSON) ? Rule<QUAD_SIMPSON>::end_weight() * (f(b) - f(a)) : 0.0;
+}
+
+// Richardson extrapolation of estimates[l] made with n 2^l panels,
+// l = 0, ..., levels - 1, for a rule of the given order.  Each column of the
+// Romberg table removes the next even power of h.  estimates is
+// overwritten, the most accurate value is returned.
+inline double richardson(double* estimates, int levels, int order)
+{
+    for (int column = 1; column < levels; ++column)
+    {
+        double factor = ldexp(1.0, order + 2 * (column - 1)) - 1.0;
+        for (int l = levels - 1; l >= column; --l)
+            estimates[l] += (estimates[l] - estimates[l - 1]) / factor;
+    }
+    return estimates[levels - 1];
+}
+
+#endif
@@ -0,0 +1,147 @@
+/*
+    Contention-free reductions for coarse grain OpenMP programs.
+
+    Each thread writes its partial result into its own cache-line sized slot,
+    the team meets at a single barrier and then every thread combines the
+    slots itself in a fixed pairwise (tree) order.  This replaces the usual
+
+        #pragma omp critical
+            total += partial;
+
+    pattern, which serializes the threads on a lock and sums in whatever order
+    the threads happen to arrive in.  Here the result only depends on the
+    number of threads and not on timing, and every thread leaves with the same
+    value so no extra broadcast or barrier is needed.
+
+    The slots are double buffered so that a fast thread can write its next
+    partial while a slow one is still reading the previous ones.  This is safe
+    as long as every thread of the team calls the reducer the same number of
+    times, which is the case for the usual "one reduction per iteration" loop.
+
+    By default the team meets at the OpenMP runtime's barrier, any object with
+    a wait(thread_ID) method (see barrier.h) can be passed in instead.
+*/
+
+#ifndef REDUCTION_H
+#define REDUCTION_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <atomic>
+#include <vector>
+
+#include <math.h>
+
+// Size of a cache line on the machines we care about (x86 and most ARM)
+#define CACHE_LINE_SIZE 64
+
+// A value padded out to a full cache line so that neighbouring slots are never
+// falsely shared between threads
+template <typename T>
+struct alignas(CACHE_LINE_SIZE) padded
+{
+    T value;
+};
+
+// Atomically replace target with max(target, value) and return the old value.
+// Max is independent of the order the updates arrive in, so unlike a summation
+// this is deterministic even when many threads race on the same variable.
+inline double atomic_max(std::atomic<double>& target, double value)
+{
+    double current = target.load(std::memory_order_relaxed);
+    while (current < value &&
+           !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        ;
+    return current;
+}
+
+class TreeReducer
+{
+public:
+
+    TreeReducer(int num_threads)
+        : num_threads(num_threads), slots(2 * num_threads), parity(num_threads)
+    {
+        for (int i = 0; i < num_threads; ++i)
+            parity[i].value = 0;
+    }
+
+    // Sum of value over all threads - must be called by every thread in the
+    // team, acts as a barrier
+    double sum(int thread_ID, double value)
+    {
+        padded<double>* s = publish(thread_ID, value);
+        return combine_sum(s, 0, num_threads);
+    }
+
+    template <typename Barrier>
+    double sum(int thread_ID, double value, Barrier& barrier)
+    {
+        padded<double>* s = publish(thread_ID, value, &barrier);
+        return combine_sum(s, 0, num_threads);
+    }
+
+    // Maximum of value over all threads - must be called by every thread in
+    // the team, acts as a barrier
+    double max(int thread_ID, double value)
+    {
+        padded<double>* s = publish(thread_ID, value);
+        return combine_max(s, 0, num_threads);
+    }
+
+    template <typename Barrier>
+    double max(int thread_ID, double value, Barrier& barrier)
+    {
+        padded<double>* s = publish(thread_ID, value, &barrier);
+        return combine_max(s, 0, num_threads);
+    }
+
+private:
+
+    int num_threads;
+    std::vector<padded<double>> slots;
+    std::vector<padded<int>> parity;
+
+    // Write our partial into the current buffer and wait for everyone else
+    struct NoBarrier { void wait(int thread_ID) {} };
+
+    template <typename Barrier = NoBarrier>
+    padded<double>* publish(int thread_ID, double value, Barrier* barrier = NULL)
+    {
+        int p = parity[thread_ID].value;
+        parity[thread_ID].value = 1 - p;
+
+        padded<double>* buffer = &slots[p * num_threads];
+        buffer[thread_ID].value = value;
+
+        if (barrier == NULL)
+        {
+            #pragma omp barrier
+        }
+        else
+            barrier->wait(thread_ID);
+
+        return buffer;
+    }
+
+    // Fixed shape binary tree over [start, end)
+    double combine_sum(padded<double>* s, int start, int end)
+    {
+        if (end - start == 1)
+            return s[start].value;
+        int middle = start + (end - start) / 2;
+        return combine_sum(s, start, middle) + combine_sum(s, middle, end);
+    }
+
+    double combine_max(padded<double>* s, int start, int end)
+    {
+        if (end - start == 1)
+            return s[start].value;
+        int middle = start + (end - start) / 2;
+        return fmax(combine_max(s, start, middle), combine_max(s, middle, end));
+    }
+};
+
+#endif
@@ -0,0 +1,292 @@
+/*
+    Reproducible summation with binned accumulators.
+
+    A plain floating point sum depends on the order of the additions, so the
+    last bits of a parallel reduction change with the number of threads or
+    ranks.  Following Demmel and Nguyen's pre-rounded summation (the scheme
+    behind ReproBLAS), each value is instead split along fixed exponent
+    boundaries into FOLDS pieces and every piece is added into the bin of its
+    boundary.  A bin holds a primary of the form 1.5 * 2^E: adding a value
+    much smaller than 2^E rounds it to a multiple of the bin's ulp 2^(E - 52),
+    and all further additions of such multiples are exact.  Exact additions
+    do not care about order, so the result only depends on the values summed
+    and not on how they were distributed or in which order partial sums were
+    combined.
+
+    The bins are laid out every BIN_WIDTH bits from the top of the double
+    range.  An accumulator keeps the FOLDS bins starting at the bin of the
+    largest magnitude seen so far (contributions further down are dropped),
+    which leaves roughly 80 bits of accuracy below the largest value.  Two
+    details make the split itself independent of the order:
+        - every value is rounded into a bin with its lowest mantissa bit set,
+          so a value exactly halfway between two multiples always rounds
+          away from zero instead of to whichever neighbour is even, and
+        - a value never contributes to bins above its own, so it does not
+          matter whether the accumulator had already moved up when it
+          arrived.
+    Every RENORM_INTERVAL additions the primaries are brought back to the
+    middle of their binade and the overflow is counted in a separate carry.
+
+    add(x, n) works through x in blocks: one vectorizable pass finds the
+    block's maximum, then the values are deposited into several independent
+    lanes of primaries with no data dependent branches.  Accumulators merge
+    exactly with add(other), which is what the OpenMP reduction
+    reproducible_sum and the MPI_Op from reproducible_sum_mpi_op() use.
+
+    Values are expected to be finite and below 2^1000 in magnitude, larger
+    ones count as infinite; infinities and NaNs propagate as in a plain sum.
+    Do not compile this with -ffast-math, it relies on (p + x) - p being
+    evaluated as written.
+*/
+
+#ifndef REPRODUCIBLE_SUM_H
+#define REPRODUCIBLE_SUM_H
+
+#include <algorithm>
+
+#include <stdint.h>
+#include <string.h>
+
+#include <math.h>
+
+class ReproducibleSum
+{
+public:
+
+    static const int FOLDS = 3;
+    static const int BIN_WIDTH = 40;
+    static const int NUM_BINS = 50;
+
+    ReproducibleSum() : index(EMPTY), special(0.0) {}
+
+    void add(double x) { deposit(&x, 1, false); }
+
+    // Add x[0], ..., x[n - 1] or their absolute values
+    void add(const double* x, long int n) { deposit(x, n, false); }
+    void add_abs(const double* x, long int n) { deposit(x, n, true); }
+
+    // Merge another accumulator into this one
+    void add(const ReproducibleSum& other)
+    {
+        special += other.special;
+        if (other.index == EMPTY)
+            return;
+
+        ReproducibleSum aligned = other;
+        aligned.raise_index(index);
+        raise_index(aligned.index);
+        for (int k = 0; k < FOLDS; ++k)
+        {
+            primary[k] += aligned.primary[k] - bin_primary(index + k);
+            carry[k] += aligned.carry[k];
+        }
+        renormalize();
+    }
+
+    // Rounded to a double, smallest bins first
+    double value() const
+    {
+        if (special != 0.0)
+            return special;
+        if (index == EMPTY)
+            return 0.0;
+
+        double total = 0.0;
+        for (int k = FOLDS - 1; k >= 0; --k)
+            total += carry[k] * bin_quarter(index + k) + (primary[k] - bin_primary(index + k));
+        return total;
+    }
+
+private:
+
+    // Exponent of the primary of bin 0, bin i has 1.5 * 2^(TOP_EXPONENT - i * BIN_WIDTH)
+    static const int TOP_EXPONENT = 1020;
+    // Values deposited into a bin with exponent E are below 2^(E - HEADROOM)
+    static const int HEADROOM = 13;
+    // Additions per primary between renormalizations, well below 2^(HEADROOM - 2)
+    static const int RENORM_INTERVAL = 1024;
+    static const int LANES = 4;
+    static const int EMPTY = NUM_BINS;
+
+    // Invariant: primaries are never further than a quarter of 2^E from the
+    // middle of their binade after renormalize()
+    double primary[FOLDS];
+    double carry[FOLDS];
+    int index;
+    double special;
+
+    static double bin_primary(int bin) { return ldexp(1.5, TOP_EXPONENT - bin * BIN_WIDTH); }
+    static double bin_quarter(int bin) { return ldexp(0.25, TOP_EXPONENT - bin * BIN_WIDTH); }
+
+    // Top bin for a magnitude m > 0, as low as possible while keeping FOLDS bins
+    static int bin_of(double m)
+    {
+        int bin = (TOP_EXPONENT - HEADROOM - 1 - ilogb(m)) / BIN_WIDTH;
+        return std::min(bin, NUM_BINS - FOLDS);
+    }
+
+    static bool in_range(double m) { return m < ldexp(1.0, TOP_EXPONENT - HEADROOM - 1); }
+
+    static double with_low_bit(double x)
+    {
+        uint64_t bits;
+        memcpy(&bits, &x, sizeof(bits));
+        bits |= 1;
+        memcpy(&x, &bits, sizeof(bits));
+        return x;
+    }
+
+    // Move the window of bins up so that it starts at bin, the lowest bins
+    // fall off the end
+    void raise_index(int bin)
+    {
+        if (bin >= index)
+            return;
+        int shift = index - bin;
+        for (int k = FOLDS - 1; k >= 0; --k)
+        {
+            if (index != EMPTY && k - shift >= 0)
+            {
+                primary[k] = primary[k - shift];
+                carry[k] = carry[k - shift];
+            }
+            else
+            {
+                primary[k] = bin_primary(bin + k);
+                carry[k] = 0.0;
+            }
+        }
+        index = bin;
+    }
+
+    // Move the multiples of a quarter binade from the primaries to the carries
+    void renormalize()
+    {
+        if (index == EMPTY)
+            return;
+        for (int k = 0; k < FOLDS; ++k)
+        {
+            double quarter = bin_quarter(index + k);
+            double c = nearbyint((primary[k] - bin_primary(index + k)) / quarter);
+            primary[k] -= c * quarter;
+            carry[k] += c;
+        }
+    }
+
+    void deposit(const double* x, long int n, bool absolute)
+    {
+        const long int BLOCK = LANES * (RENORM_INTERVAL / 4);
+
+        for (long int start = 0; start < n; start += BLOCK)
+        {
+            long int length = std::min(BLOCK, n - start);
+            const double* block = x + start;
+
+            double m = 0.0;
+            int out_of_range = 0;
+            #pragma omp simd reduction(max : m) reduction(| : out_of_range)
+            for (long int i = 0; i < length; ++i)
+            {
+                double a = fabs(block[i]);
+                m = std::max(m, a);
+                out_of_range |= !in_range(a);
+            }
+
+            // Rare, send the offenders to special one at a time
+            if (out_of_range)
+            {
+                for (long int i = 0; i < length; ++i)
+                {
+                    double v = absolute ? fabs(block[i]) : block[i];
+                    if (in_range(fabs(v)))
+                        deposit(&v, 1, false);
+                    else
+                        special += isfinite(v) ? copysign(INFINITY, v) : v;
+                }
+                continue;
+            }
+            if (m == 0.0)
+                continue;
+
+            raise_index(bin_of(m));
+
+            // Independent primaries per lane, merged exactly at the end
+            double p[FOLDS][LANES];
+            for (int k = 0; k < FOLDS; ++k)
+                for (int l = 0; l < LANES; ++l)
+                    p[k][l] = bin_primary(index + k);
+
+            long int i = 0;
+            for (; i + LANES <= length; i += LANES)
+            {
+                for (int l = 0; l < LANES; ++l)
+                {
+                    double r = absolute ? fabs(block[i + l]) : block[i + l];
+                    for (int k = 0; k < FOLDS - 1; ++k)
+                    {
+                        double t = p[k][l] + with_low_bit(r);
+                        r -= t - p[k][l];
+                        p[k][l] = t;
+                    }
+                    p[FOLDS - 1][l] += with_low_bit(r);
+                }
+            }
+            for (; i < length; ++i)
+            {
+                double r = absolute ? fabs(block[i]) : block[i];
+                for (int k = 0; k < FOLDS - 1; ++k)
+                {
+                    double t = p[k][0] + with_low_bit(r);
+                    r -= t - p[k][0];
+                    p[k][0] = t;
+                }
+                p[FOLDS - 1][0] += with_low_bit(r);
+            }
+
+            for (int k = 0; k < FOLDS; ++k)
+                for (int l = 0; l < LANES; ++l)
+                    primary[k] += p[k][l] - bin_primary(index + k);
+            renormalize();
+        }
+    }
+};
+
+// Exact merge of per-thread accumulators, e.g.
+//     #pragma omp parallel for reduction(reproducible_sum : total)
+#pragma omp declare reduction(reproducible_sum : ReproducibleSum : omp_out.add(omp_in)) \
+                    initializer(omp_priv = ReproducibleSum())
+
+// MPI support when mpi.h was included first.  The accumulator is sent as raw
+// bytes, which is fine as long as all ranks share the same architecture.
+#ifdef MPI_VERSION
+inline void reproducible_sum_combine(void* in, void* inout, int* length, MPI_Datatype* type)
+{
+    ReproducibleSum* a = (ReproducibleSum*)in;
+    ReproducibleSum* b = (ReproducibleSum*)inout;
+    for (int i = 0; i < *length; ++i)
+        b[i].add(a[i]);
+}
+
+inline MPI_Datatype reproducible_sum_mpi_type()
+{
+    static MPI_Datatype type = MPI_DATATYPE_NULL;
+    if (type == MPI_DATATYPE_NULL)
+    {
+        MPI_Type_contiguous(sizeof(ReproducibleSum), MPI_BYTE, &type);
+        MPI_Type_commit(&type);
+    }
+    return type;
+}
+
+// Merging is exact, so the operation is commutative and MPI may combine the
+// ranks in any order
+inline MPI_Op reproducible_sum_mpi_op()
+{
+    static MPI_Op op = MPI_OP_NULL;
+    if (op == MPI_OP_NULL)
+        MPI_Op_create(&reproducible_sum_combine, 1, &op);
+    return op;
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/*
+    Multiplies of small matrices with sizes known at compile time, C = A B
+    for row-major A (M x K), B (K x N) and C (M x N), say 4 x 4 to 32 x 32.
+
+    For matrices this small the blocking and packing of gemm.h, or a BLAS
+    call, costs more than the multiply.  Here every loop bound is a template
+    parameter, so the compiler unrolls the loops completely and keeps rows of
+    C in vector registers:
+        small::gemm<M, N, K>(A, B, C)       one product, vectorized along the
+                                            rows of C (N wide)
+    A batch of many products vectorizes better across the batch: with LANES
+    matrices interleaved entry by entry, entry e of matrix b is at
+        (b / LANES) * rows * columns * LANES + e * LANES + b % LANES
+    so each vector holds the same entry of LANES matrices, the products need
+    no shuffles and all sizes fill the vectors, whatever N is.
+        small::interleave<R, C>(count, matrices, interleaved)
+        small::gemm_batched<M, N, K>(count, A, B, C)
+        small::deinterleave<R, C>(count, interleaved, matrices)
+    Interleaved buffers hold whole groups of LANES matrices, size them with
+    small::interleaved_size().  gemm_batched() spreads the groups over the
+    OpenMP threads.  Build with -O3 -march=native, and with AVX-512 also
+    -mprefer-vector-width=512 for small::gemm().
+
+    The batched layout pays off for the smallest sizes and only while the
+    batch is cache resident.  On one AVX-512 core (batched_gemm) 4 x 4
+    products run about 7x faster than one dgemm call each at a batch of
+    2000, but only 1.4-2x at 100000 where both are bound by memory, and
+    8 x 8 ones about 1.2x.  From 16 x 16 on dgemm has enough work per call
+    and the interleaved layout loses to it, 0.85-0.97x at 16 x 16 and
+    0.53-0.7x at 32 x 32; small::gemm() stays about even with dgemm there.
+*/
+
+#ifndef SMALL_GEMM_H
+#define SMALL_GEMM_H
+
+#include <stddef.h>
+
+namespace small
+{
+    // Matrices per group of the interleaved layout, one AVX-512 vector of
+    // doubles
+    int const LANES = 8;
+
+    // The same entry of the LANES matrices of a group, as a GCC vector, so
+    // that the accumulators stay in registers (zmm with AVX-512, pairs or
+    // quads of narrower ones otherwise); loads need only double alignment
+    typedef double lanes __attribute__((vector_size(LANES * sizeof(double)), aligned(sizeof(double)), may_alias));
+
+    // Doubles of an interleaved batch of count matrices with size entries
+    inline size_t interleaved_size(long int count, int size)
+    {
+        return (size_t)((count + LANES - 1) / LANES) * size * LANES;
+    }
+
+    // Row and column blocks of C kept in registers, as large as divide the
+    // sizes: 4 rows of C by N for one product, 2 x 8 entries of LANES
+    // products for a batch
+    template <int S, int B>
+    constexpr int block(int b = B)
+    {
+        return (S % b == 0) ? b : block<S, B>(b / 2);
+    }
+
+    template <int M, int N, int K>
+    inline void gemm(const double* A, const double* B, double* C)
+    {
+        int const MB = block<M, 4>();
+
+        for (int i = 0; i < M; i += MB)
+        {
+            double rows[MB][N] = {};
+            #pragma GCC unroll 32
+            for (int k = 0; k < K; ++k)
+            {
+                for (int ii = 0; ii < MB; ++ii)
+                {
+                    double a = A[(i + ii) * K + k];
+                    #pragma omp simd
+                    for (int j = 0; j < N; ++j)
+                        rows[ii][j] += a * B[k * N + j];
+                }
+            }
+            for (int ii = 0; ii < MB; ++ii)
+                for (int j = 0; j < N; ++j)
+                    C[(i + ii) * N + j] = rows[ii][j];
+        }
+    }
+
+    // Products of the count interleaved pairs of A and B
+    template <int M, int N, int K>
+    inline void gemm_batched(long int count, const double* A, const double* B, double* C)
+    {
+        int const MB = block<M, 2>(), NB = block<N, 8>();
+        long int groups = (count + LANES - 1) / LANES;
+
+        #pragma omp parallel for schedule(static)
+        for (long int g = 0; g < groups; ++g)
+        {
+            const double* a = A + (size_t)g * M * K * LANES;
+            const double* b = B + (size_t)g * K * N * LANES;
+            double* c = C + (size_t)g * M * N * LANES;
+
+            for (int i = 0; i < M; i += MB)
+                for (int j = 0; j < N; j += NB)
+                {
+                    lanes tile[MB][NB] = {};
+                    for (int k = 0; k < K; ++k)
+                        #pragma GCC unroll 8
+                        for (int ii = 0; ii < MB; ++ii)
+                        {
+                            lanes x = *(const lanes*)(a + ((i + ii) * K + k) * LANES);
+                            #pragma GCC unroll 8
+                            for (int jj = 0; jj < NB; ++jj)
+                                tile[ii][jj] += x * *(const lanes*)(b + (k * N + j + jj) * LANES);
+                        }
+                    for (int ii = 0; ii < MB; ++ii)
+                        for (int jj = 0; jj < NB; ++jj)
+                            *(lanes*)(c + ((i + ii) * N + j + jj) * LANES) = tile[ii][jj];
+                }
+        }
+    }
+
+    // count R x C matrices stored one after the other to the interleaved
+    // layout and back, the unused lanes of the last group are zeroed
+    template <int R, int C>
+    inline void interleave(long int count, const double* matrices, double* interleaved)
+    {
+        long int padded = (count + LANES - 1) / LANES * LANES;
+
+        #pragma omp parallel for schedule(static)
+        for (long int m = 0; m < padded; ++m)
+        {
+            double* out = interleaved + (size_t)(m / LANES) * R * C * LANES + m % LANES;
+            for (int e = 0; e < R * C; ++e)
+                out[e * LANES] = (m < count) ? matrices[(size_t)m * R * C + e] : 0.0;
+        }
+    }
+
+    template <int R, int C>
+    inline void deinterleave(long int count, const double* interleaved, double* matrices)
+    {
+        #pragma omp parallel for schedule(static)
+        for (long int m = 0; m < count; ++m)
+        {
+            const double* in = interleaved + (size_t)(m / LANES) * R * C * LANES + m % LANES;
+            for (int e = 0; e < R * C; ++e)
+                matrices[(size_t)m * R * C + e] = in[e * LANES];
+        }
+    }
+}
+
+#endif
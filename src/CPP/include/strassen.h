@@ -0,0 +1,217 @@
+/*
+    Strassen-Winograd multiply of square matrices, C = A B, row-major, on
+    top of the blocked gemm() of gemm.h.
+
+    Splitting each matrix into 2 x 2 blocks of size h = n / 2, Winograd's form
+    of Strassen's algorithm needs 7 block products and 15 block additions
+    instead of 8 products:
+        S1 = A21 + A22   S2 = S1 - A11    S3 = A11 - A21   S4 = A12 - S2
+        T1 = B12 - B11   T2 = B22 - T1    T3 = B22 - B12   T4 = T2 - B21
+        P1 = A11 B11     P2 = A12 B21     P3 = S4 B22      P4 = A22 T4
+        P5 = S1 T1       P6 = S2 T2       P7 = S3 T3
+        U2 = P1 + P6     U3 = U2 + P7
+        C11 = P1 + P2    C12 = U2 + P5 + P3
+        C21 = U3 - P4    C22 = U3 + P5
+    The products recurse until the blocks are no larger than the crossover,
+    which are left to gemm(), so the cost is O(n^2.81) above it.  The
+    crossover depends on how fast gemm() is compared to the additions, which
+    only run at memory speed, and is best found by measurement.
+
+    Accuracy: the additions mix entries of different size, so the error bound
+    grows by a constant factor per level instead of staying ~ n eps.  Each
+    level of recursion typically costs a few bits; set the crossover so that
+    the depth stays small.
+
+    Memory: everything comes from one arena allocated before the recursion.
+    A level takes 11 h x h temporaries (S1-S4, T1-T4, P1, P6 and P7, the
+    other products go straight into the blocks of C) and hands the rest to
+    its products.  Serial products run one after the other and share the
+    rest; products run as OpenMP tasks at the top levels each get a slice of
+    their own.  Sizes that do not halve evenly down to the crossover are
+    padded with zeros once, at the top.
+
+    Call strassen() from outside of a parallel region.
+*/
+
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include "gemm.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <stddef.h>
+#include <vector>
+
+namespace strassen_detail
+{
+    // h x h temporaries rounded up to whole cache lines, so that every slice
+    // of the arena stays 64 byte aligned
+    inline size_t block_size(int h)
+    {
+        return ((size_t)h * h + 7) / 8 * 8;
+    }
+
+    // Doubles of arena the recursion below an n x n product needs
+    inline size_t arena_size(int n, int crossover, int task_levels)
+    {
+        if (n <= crossover)
+            return 0;
+        int h = n / 2;
+        return 11 * block_size(h) + (task_levels > 0 ? 7 : 1) * arena_size(h, crossover, task_levels - 1);
+    }
+
+    // Z = X + Y and Z = X - Y for h x h blocks
+    inline void add(int h, const double* X, int ldx, const double* Y, int ldy, double* Z, int ldz)
+    {
+        for (int i = 0; i < h; ++i)
+            for (int j = 0; j < h; ++j)
+                Z[(size_t)i * ldz + j] = X[(size_t)i * ldx + j] + Y[(size_t)i * ldy + j];
+    }
+
+    inline void subtract(int h, const double* X, int ldx, const double* Y, int ldy, double* Z, int ldz)
+    {
+        for (int i = 0; i < h; ++i)
+            for (int j = 0; j < h; ++j)
+                Z[(size_t)i * ldz + j] = X[(size_t)i * ldx + j] - Y[(size_t)i * ldy + j];
+    }
+
+    // C = A B for n x n blocks, n a power of two times at most the crossover
+    inline void multiply(int n, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+                         int crossover, int task_levels, double* arena)
+    {
+        if (n <= crossover)
+        {
+            gemm(n, n, n, 1.0, A, lda, B, ldb, 0.0, C, ldc);
+            return;
+        }
+
+        int h = n / 2;
+        const double *A11 = A, *A12 = A + h, *A21 = A + (size_t)h * lda, *A22 = A21 + h;
+        const double *B11 = B, *B12 = B + h, *B21 = B + (size_t)h * ldb, *B22 = B21 + h;
+        double *C11 = C, *C12 = C + h, *C21 = C + (size_t)h * ldc, *C22 = C21 + h;
+
+        size_t size = block_size(h);
+        double *S1 = arena, *S2 = S1 + size, *S3 = S2 + size, *S4 = S3 + size;
+        double *T1 = S4 + size, *T2 = T1 + size, *T3 = T2 + size, *T4 = T3 + size;
+        double *P1 = T4 + size, *P6 = P1 + size, *P7 = P6 + size;
+        double* rest = P7 + size;
+
+        add(h, A21, lda, A22, lda, S1, h);
+        subtract(h, S1, h, A11, lda, S2, h);
+        subtract(h, A11, lda, A21, lda, S3, h);
+        subtract(h, A12, lda, S2, h, S4, h);
+        subtract(h, B12, ldb, B11, ldb, T1, h);
+        subtract(h, B22, ldb, T1, h, T2, h);
+        subtract(h, B22, ldb, B12, ldb, T3, h);
+        subtract(h, T2, h, B21, ldb, T4, h);
+
+        // P2 to P5 go to C11, C12, C21 and C22 and are combined in place
+        struct Product { const double* X; int ldx; const double* Y; int ldy; double* Z; int ldz; };
+        Product const products[7] = {
+            {A11, lda, B11, ldb, P1, h}, {A12, lda, B21, ldb, C11, ldc}, {S4, h, B22, ldb, C12, ldc},
+            {A22, lda, T4, h, C21, ldc}, {S1, h, T1, h, C22, ldc}, {S2, h, T2, h, P6, h}, {S3, h, T3, h, P7, h}};
+
+        if (task_levels > 0)
+        {
+            size_t slice = arena_size(h, crossover, task_levels - 1);
+            for (int p = 0; p < 7; ++p)
+            {
+                #pragma omp task firstprivate(p)
+                multiply(h, products[p].X, products[p].ldx, products[p].Y, products[p].ldy, products[p].Z,
+                         products[p].ldz, crossover, task_levels - 1, rest + p * slice);
+            }
+            #pragma omp taskwait
+        }
+        else
+        {
+            for (int p = 0; p < 7; ++p)
+                multiply(h, products[p].X, products[p].ldx, products[p].Y, products[p].ldy, products[p].Z,
+                         products[p].ldz, crossover, 0, rest);
+        }
+
+        add(h, C11, ldc, P1, h, C11, ldc);
+        add(h, P1, h, P6, h, P6, h);            // U2
+        add(h, P6, h, P7, h, P7, h);            // U3
+        add(h, P6, h, C22, ldc, P6, h);         // U2 + P5
+        add(h, P6, h, C12, ldc, C12, ldc);
+        subtract(h, P7, h, C21, ldc, C21, ldc);
+        add(h, P7, h, C22, ldc, C22, ldc);
+    }
+}
+
+// C = A B for N x N matrices.  Blocks of at most crossover rows are
+// multiplied by gemm(), task_levels of recursion (by default enough for
+// every thread to have a product) run their 7 products as OpenMP tasks
+inline void strassen(int N, const double* A, int lda, const double* B, int ldb, double* C, int ldc,
+                     int crossover = 512, int task_levels = -1)
+{
+    using namespace strassen_detail;
+
+    if (crossover < 1)
+        crossover = 1;
+
+    // Levels of recursion, and N rounded up so that it halves evenly
+    int depth = 0, base = N;
+    while (base > crossover)
+    {
+        base = (base + 1) / 2;
+        ++depth;
+    }
+    int n = base << depth;
+
+    int threads = 1;
+#ifdef _OPENMP
+    threads = omp_get_max_threads();
+#endif
+    if (task_levels < 0)
+    {
+        task_levels = 0;
+        for (int tasks = 1; tasks < threads; tasks *= 7)
+            ++task_levels;
+    }
+    if (task_levels > depth)
+        task_levels = depth;
+
+    // One allocation for the whole recursion, plus padded copies if needed
+    size_t padded = (n == N) ? 0 : block_size(n);
+    std::vector<double> buffer(arena_size(n, crossover, task_levels) + 3 * padded + 7);
+    double* arena = gemm_detail::align(buffer);
+
+    const double *a = A, *b = B;
+    double* c = C;
+    int ld_a = lda, ld_b = ldb, ld_c = ldc;
+    if (padded > 0)
+    {
+        double *A_padded = arena, *B_padded = A_padded + padded, *C_padded = B_padded + padded;
+        arena = C_padded + padded;
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+            {
+                A_padded[(size_t)i * n + j] = A[(size_t)i * lda + j];
+                B_padded[(size_t)i * n + j] = B[(size_t)i * ldb + j];
+            }
+        a = A_padded;
+        b = B_padded;
+        c = C_padded;
+        ld_a = ld_b = ld_c = n;
+    }
+
+    if (task_levels > 0)
+    {
+        #pragma omp parallel
+        #pragma omp single
+        multiply(n, a, ld_a, b, ld_b, c, ld_c, crossover, task_levels, arena);
+    }
+    else
+        multiply(n, a, ld_a, b, ld_b, c, ld_c, crossover, 0, arena);
+
+    if (padded > 0)
+        for (int i = 0; i < N; ++i)
+            for (int j = 0; j < N; ++j)
+                C[(size_t)i * ldc + j] = c[(size_t)i * n + j];
+}
+
+#endif
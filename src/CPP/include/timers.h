@@ -0,0 +1,161 @@
+/*
+    Per-phase wall clock timers for the MPI programs.
+
+    A program names its phases once and then wraps each piece of work in a
+    scoped timer, which adds the time between its construction and the end
+    of the scope to the phase:
+
+        enum Phase { INIT, COMPUTE, HALO };
+        PhaseTimers timers({"init", "compute", "halo"});
+        ...
+        {
+            ScopedTimer timer(timers, COMPUTE);
+            ... stencil ...
+        }
+        ...
+        timers.report(MPI_COMM_WORLD, cout);
+
+    A scope costs two reads of std::chrono::steady_clock (the vDSO
+    clock_gettime that MPI_Wtime also uses, some 20 ns each) and two adds to
+    arrays indexed by the phase number, so the timers can stay in production
+    runs as long as a scope holds more than a few hundred nanoseconds of work.
+    Stretches of code that do not
+    form a scope of their own use timers.start(PHASE) and timers.stop(PHASE)
+    instead.  After timers.trace_to(tracer) every timed stretch is also an
+    event of thread 0 in a trace (trace.h) with the phase as its name.
+
+    report() is collective: MPI_Reduce calls gather the minimum, sum and
+    maximum of every phase over the ranks, and the root prints per phase the
+    calls, the min / avg / max seconds, the load imbalance max / avg (1 is
+    perfect balance) and the share of the average run time.  "calls" is the
+    number of timed stretches, not of iterations: a phase timed in two places
+    per iteration has twice as many calls, so give each piece of work its own
+    phase when calls should count iterations.  "other" is the time since the
+    timers were created minus the sum over the phases.  Nested scopes are
+    each counted in full, so time inside a nested scope is counted twice in
+    that sum and "other" comes out too small (even negative); keep the
+    scopes of different phases disjoint.
+*/
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+// MPI Library
+#include "mpi.h"
+
+// Timelines of the phases
+#include "trace.h"
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+class PhaseTimers
+{
+public:
+
+    explicit PhaseTimers(std::vector<std::string> const& phase_names)
+        : names(phase_names), seconds(phase_names.size(), 0.0), calls(phase_names.size(), 0),
+          started(phase_names.size(), 0.0), created(now()) {}
+
+    // Seconds from an arbitrary, fixed origin
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void add(int phase, double elapsed)
+    {
+        seconds[phase] += elapsed;
+        calls[phase]++;
+    }
+
+    // The stretch from begin to end, also traced
+    void interval(int phase, double begin, double end)
+    {
+        add(phase, end - begin);
+        if (tracer != nullptr)
+            tracer->record(0, phase, begin, end);
+    }
+
+    void start(int phase) { started[phase] = now(); }
+    void stop(int phase) { interval(phase, started[phase], now()); }
+
+    void trace_to(Tracer& phase_tracer) { tracer = &phase_tracer; }
+
+    double total(int phase) const { return seconds[phase]; }
+
+    // Collective over comm, the table is printed on root
+    void report(MPI_Comm comm, std::ostream& out, int root = 0) const
+    {
+        int rank, num_procs;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &num_procs);
+
+        // The phases and then the untimed rest
+        int num_phases = (int)names.size();
+        std::vector<double> local(seconds), minimum(num_phases + 1), sum(num_phases + 1), maximum(num_phases + 1);
+        double timed = 0.0;
+        for (double s : seconds)
+            timed += s;
+        local.push_back(now() - created - timed);
+        std::vector<long int> local_calls(calls), max_calls(num_phases);
+
+        MPI_Reduce(local.data(), minimum.data(), num_phases + 1, MPI_DOUBLE, MPI_MIN, root, comm);
+        MPI_Reduce(local.data(), sum.data(), num_phases + 1, MPI_DOUBLE, MPI_SUM, root, comm);
+        MPI_Reduce(local.data(), maximum.data(), num_phases + 1, MPI_DOUBLE, MPI_MAX, root, comm);
+        MPI_Reduce(local_calls.data(), max_calls.data(), num_phases, MPI_LONG, MPI_MAX, root, comm);
+        if (rank != root)
+            return;
+
+        double run = 0.0;
+        for (double s : sum)
+            run += s / num_procs;
+
+        char line[256];
+        snprintf(line, sizeof(line), "%-12s %10s %11s %11s %11s %9s %7s\n", "phase", "calls", "min s", "avg s",
+                 "max s", "max/avg", "% run");
+        out << "Timers over " << num_procs << " ranks:\n" << line;
+        for (int p = 0; p <= num_phases; ++p)
+        {
+            double average = sum[p] / num_procs;
+            snprintf(line, sizeof(line), "%-12s %10ld %11.4e %11.4e %11.4e %9.3f %7.2f\n",
+                     (p < num_phases ? names[p] : std::string("other")).substr(0, 12).c_str(),
+                     p < num_phases ? max_calls[p] : 0L, minimum[p], average, maximum[p],
+                     average > 0.0 ? maximum[p] / average : 1.0, run > 0.0 ? 100.0 * average / run : 0.0);
+            out << line;
+        }
+    }
+
+private:
+
+    std::vector<std::string> names;
+    std::vector<double> seconds;
+    std::vector<long int> calls;
+    std::vector<double> started;
+    double created;
+    Tracer* tracer = nullptr;
+};
+
+// Adds the lifetime of the object to a phase
+class ScopedTimer
+{
+public:
+
+    ScopedTimer(PhaseTimers& timers, int phase) : timers(timers), phase(phase), start(PhaseTimers::now()) {}
+    ~ScopedTimer() { timers.interval(phase, start, PhaseTimers::now()); }
+
+    ScopedTimer(ScopedTimer const&) = delete;
+    ScopedTimer& operator=(ScopedTimer const&) = delete;
+
+private:
+
+    PhaseTimers& timers;
+    int phase;
+    double start;
+};
+
+#endif
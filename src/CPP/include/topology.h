@@ -0,0 +1,306 @@
+/*
+    Where threads and ranks landed: core, socket, NUMA node and L3 cache of
+    the CPU each one runs on, the CPUs it may run on, and the problems that
+    show up when several share a CPU or a core (Linux only).
+
+    The place of a CPU comes from sysfs:
+        /sys/devices/system/cpu/cpuN/topology/core_id
+        /sys/devices/system/cpu/cpuN/topology/physical_package_id
+        /sys/devices/system/cpu/cpuN/nodeM (cpu_node() of affinity.h)
+        /sys/devices/system/cpu/cpuN/cache/indexK with level 3, its id (or
+            the first CPU of shared_cpu_list on older kernels)
+    and the allowed CPUs from sched_getaffinity() of the calling thread.
+
+    Layouts are written and read as CSV, one line per worker:
+        host,rank,thread,cpu,core,socket,node,l3,allowed
+    with allowed a list like 0-3;8.  A solver can pin thread t of its rank
+    to layout_cpus(path, host, rank)[t] with pin_to_cpu() from affinity.h.
+
+    On other platforms everything reports -1.
+*/
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include "affinity.h"
+
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+struct CpuPlace
+{
+    int cpu = -1, core = -1, socket = -1, node = -1, l3 = -1;
+};
+
+// Everything a worker (a thread of a rank) needs to know about its place
+struct Placement
+{
+    std::string host;
+    int rank = 0, thread = 0;
+    CpuPlace place;
+    std::vector<int> allowed;
+};
+
+namespace topology_detail
+{
+    // First integer in a sysfs file, -1 if it does not exist
+    inline int read_int(std::string const& path)
+    {
+        int value = -1;
+        FILE* file = fopen(path.c_str(), "r");
+        if (file == NULL)
+            return -1;
+        if (fscanf(file, "%d", &value) != 1)
+            value = -1;
+        fclose(file);
+        return value;
+    }
+}
+
+// CPU numbers to ranges, {0, 1, 2, 3, 8} is "0-3;8"
+inline std::string cpu_list(std::vector<int> const& cpus)
+{
+    std::string list;
+    for (size_t i = 0; i < cpus.size(); )
+    {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            ++j;
+        list += (list.empty() ? "" : ";") + std::to_string(cpus[i]);
+        if (j > i)
+            list += "-" + std::to_string(cpus[j]);
+        i = j + 1;
+    }
+    return list;
+}
+
+// And back, also taking the commas of sysfs lists
+inline std::vector<int> parse_cpu_list(std::string const& list)
+{
+    std::vector<int> cpus;
+    std::string range;
+    std::stringstream stream(list);
+    while (std::getline(stream, range, list.find(';') != std::string::npos ? ';' : ','))
+    {
+        if (range.empty())
+            continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range), last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+inline CpuPlace cpu_place(int cpu)
+{
+    CpuPlace place;
+    place.cpu = cpu;
+    if (cpu < 0)
+        return place;
+
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    place.core = topology_detail::read_int(path + "/topology/core_id");
+    place.socket = topology_detail::read_int(path + "/topology/physical_package_id");
+    place.node = cpu_node(cpu);
+    for (int index = 0; index < 8; ++index)
+    {
+        std::string cache = path + "/cache/index" + std::to_string(index);
+        if (topology_detail::read_int(cache + "/level") != 3)
+            continue;
+        place.l3 = topology_detail::read_int(cache + "/id");
+        if (place.l3 < 0)
+        {
+            std::ifstream shared(cache + "/shared_cpu_list");
+            std::string list;
+            shared >> list;
+            std::vector<int> cpus = parse_cpu_list(list);
+            place.l3 = cpus.empty() ? -1 : cpus[0];
+        }
+        break;
+    }
+    return place;
+}
+
+// CPUs the calling thread may run on
+inline std::vector<int> thread_affinity()
+{
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t mask;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+            if (CPU_ISSET(cpu, &mask))
+                cpus.push_back(cpu);
+#endif
+    return cpus;
+}
+
+inline std::string host_name()
+{
+    char name[256] = "unknown";
+#ifdef __linux__
+    gethostname(name, sizeof(name) - 1);
+#endif
+    return name;
+}
+
+// The calling thread, to be called by every thread of every rank
+inline Placement current_placement(int rank, int thread)
+{
+    Placement p;
+    p.host = host_name();
+    p.rank = rank;
+    p.thread = thread;
+    p.place = cpu_place(current_cpu());
+    p.allowed = thread_affinity();
+    return p;
+}
+
+inline std::string layout_header()
+{
+    return "host,rank,thread,cpu,core,socket,node,l3,allowed";
+}
+
+inline std::string layout_line(Placement const& p)
+{
+    return p.host + "," + std::to_string(p.rank) + "," + std::to_string(p.thread) + "," +
+           std::to_string(p.place.cpu) + "," + std::to_string(p.place.core) + "," +
+           std::to_string(p.place.socket) + "," + std::to_string(p.place.node) + "," +
+           std::to_string(p.place.l3) + "," + cpu_list(p.allowed);
+}
+
+// false for the header and anything else that is not a layout line
+inline bool parse_layout_line(std::string const& line, Placement& p)
+{
+    std::vector<std::string> fields;
+    std::string field;
+    std::stringstream stream(line);
+    while (std::getline(stream, field, ','))
+        fields.push_back(field);
+    if (fields.size() < 8 || fields[1].empty() || !isdigit(fields[1][0]))
+        return false;
+
+    p.host = fields[0];
+    p.rank = std::stoi(fields[1]);
+    p.thread = std::stoi(fields[2]);
+    p.place.cpu = std::stoi(fields[3]);
+    p.place.core = std::stoi(fields[4]);
+    p.place.socket = std::stoi(fields[5]);
+    p.place.node = std::stoi(fields[6]);
+    p.place.l3 = std::stoi(fields[7]);
+    p.allowed = parse_cpu_list(fields.size() > 8 ? fields[8] : "");
+    return true;
+}
+
+inline void write_layout(std::ostream& out, std::vector<Placement> const& layout)
+{
+    out << layout_header() << "\n";
+    for (Placement const& p : layout)
+        out << layout_line(p) << "\n";
+}
+
+inline std::vector<Placement> read_layout(std::string const& path)
+{
+    std::vector<Placement> layout;
+    std::ifstream in(path);
+    std::string line;
+    Placement p;
+    while (std::getline(in, line))
+        if (parse_layout_line(line, p))
+            layout.push_back(p);
+    return layout;
+}
+
+// CPU of every thread of a rank on a host, in thread order, empty if the
+// layout does not have the rank
+inline std::vector<int> layout_cpus(std::string const& path, std::string const& host, int rank)
+{
+    std::map<int, int> cpus;
+    for (Placement const& p : read_layout(path))
+        if (p.host == host && p.rank == rank)
+            cpus[p.thread] = p.place.cpu;
+    std::vector<int> ordered;
+    for (auto const& thread : cpus)
+        ordered.push_back(thread.second);
+    return ordered;
+}
+
+// Human readable table, one line per worker
+inline void print_layout(std::ostream& out, std::vector<Placement> const& layout)
+{
+    out << "host            rank thread   cpu  core socket  node    l3  allowed\n";
+    for (Placement const& p : layout)
+    {
+        char line[256];
+        snprintf(line, sizeof(line), "%-15s %4d %6d %5d %5d %6d %5d %5d  %s\n", p.host.substr(0, 15).c_str(),
+                 p.rank, p.thread, p.place.cpu, p.place.core, p.place.socket, p.place.node, p.place.l3,
+                 cpu_list(p.allowed).c_str());
+        out << line;
+    }
+}
+
+// Oversubscribed hosts and CPUs, workers on sibling hyperthreads of a core
+// and workers that are not pinned, one message each
+inline std::vector<std::string> check_layout(std::vector<Placement> const& layout)
+{
+    std::vector<std::string> problems;
+    auto name = [](Placement const& p) { return std::to_string(p.rank) + "." + std::to_string(p.thread); };
+
+    std::map<std::string, std::vector<Placement>> hosts;
+    for (Placement const& p : layout)
+        hosts[p.host].push_back(p);
+
+    for (auto const& host : hosts)
+    {
+        std::vector<Placement> const& workers = host.second;
+        std::set<int> cpus_allowed;
+        std::map<int, std::vector<std::string>> on_cpu;
+        std::map<std::pair<int, int>, std::set<int>> core_cpus;
+        std::vector<std::string> unpinned;
+        for (Placement const& p : workers)
+        {
+            cpus_allowed.insert(p.allowed.begin(), p.allowed.end());
+            on_cpu[p.place.cpu].push_back(name(p));
+            core_cpus[{p.place.socket, p.place.core}].insert(p.place.cpu);
+            if (p.allowed.size() > 1)
+                unpinned.push_back(name(p));
+        }
+
+        if (workers.size() > cpus_allowed.size())
+            problems.push_back(host.first + ": " + std::to_string(workers.size()) + " workers on " +
+                               std::to_string(cpus_allowed.size()) + " allowed CPUs, oversubscribed");
+        for (auto const& cpu : on_cpu)
+            if (cpu.second.size() > 1)
+            {
+                std::string who;
+                for (std::string const& w : cpu.second)
+                    who += " " + w;
+                problems.push_back(host.first + ": CPU " + std::to_string(cpu.first) + " shared by rank.thread" + who);
+            }
+        for (auto const& core : core_cpus)
+            if (core.second.size() > 1 && core.first.second >= 0)
+                problems.push_back(host.first + ": core " + std::to_string(core.first.second) + " of socket " +
+                                   std::to_string(core.first.first) + " runs workers on CPUs " +
+                                   cpu_list(std::vector<int>(core.second.begin(), core.second.end())) +
+                                   ", hyperthreads share its caches and units");
+        if (!unpinned.empty())
+            problems.push_back(host.first + ": " + std::to_string(unpinned.size()) + " of " +
+                               std::to_string(workers.size()) + " workers may migrate between CPUs, not pinned");
+    }
+    return problems;
+}
+
+#endif
@@ -0,0 +1,272 @@
+/*
+    Event traces of threads and ranks for the Chrome trace viewer
+    (chrome://tracing) and Perfetto (ui.perfetto.dev).
+
+    Every thread records complete events, a name with begin and end times,
+    into a ring buffer of its own that is allocated up front, so recording is
+    two clock reads and a store without locks or allocation:
+
+        enum Event { SWEEP, REDUCE };
+        Tracer tracer({"sweep", "reduce"}, num_threads, 1 << 16, stride);
+        ...
+        tracer.set_iteration(thread, iteration);
+        {
+            TraceScope scope(tracer, thread, SWEEP);
+            ... work ...
+        }
+        ...
+        tracer.write("trace.json");
+
+    Only iterations that are a multiple of stride are recorded, and a full
+    ring keeps the latest events, so the trace of a run of millions of
+    iterations stays at the size of the buffers.  A stride of 0 turns
+    tracing off, then a scope costs one branch.
+
+    With MPI (mpi.h included before this header) write_trace() gathers the
+    events of all ranks to the root.  The clocks of different hosts are not
+    synchronized, so the root measures the offset of every rank's clock in a
+    few ping-pongs, keeps the one with the shortest round trip (the error is
+    at most half of it) and the events are shifted onto its clock.  Ranks
+    become processes and threads threads in the viewer.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+
+class Tracer
+{
+public:
+
+    Tracer(std::vector<std::string> const& event_names, int num_threads = 1, size_t capacity = 1 << 16,
+           long int stride = 1)
+        : names(event_names), rings(num_threads), capacity(stride > 0 ? capacity : 0), stride(stride),
+          created(now())
+    {
+        for (Ring& ring : rings)
+        {
+            ring.events.resize(this->capacity);
+            ring.on = (this->capacity > 0);
+        }
+    }
+
+    // Seconds from an arbitrary, fixed origin, the clock of timers.h
+    static double now()
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // Called by a thread at the top of every iteration, decides whether its
+    // events are recorded.  Negative iterations, before and after the loop,
+    // are always recorded.
+    void set_iteration(int thread, long int iteration)
+    {
+        Ring& ring = rings[thread];
+        ring.iteration = iteration;
+        ring.on = (capacity > 0 && (iteration < 0 || iteration % stride == 0));
+    }
+
+    bool recording(int thread) const { return rings[thread].on; }
+
+    void record(int thread, int name, double begin, double end)
+    {
+        Ring& ring = rings[thread];
+        if (!ring.on)
+            return;
+        ring.events[ring.count++ % capacity] = {begin, end, ring.iteration, name};
+    }
+
+    bool enabled() const { return capacity > 0; }
+    double start_time() const { return created; }
+
+    // Events overwritten because a ring was full
+    size_t dropped() const
+    {
+        size_t lost = 0;
+        for (Ring const& ring : rings)
+            lost += (ring.count > capacity) ? ring.count - capacity : 0;
+        return lost;
+    }
+
+    // Comma separated trace events of this process, times in microseconds
+    // after origin on a clock that is shift ahead of ours
+    std::string events_json(int pid, double origin, double shift = 0.0) const
+    {
+        std::string json;
+        char line[256];
+        snprintf(line, sizeof(line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                 "\"args\":{\"name\":\"rank %d\"}}", pid, pid);
+        json += line;
+        if (dropped() > 0)
+        {
+            snprintf(line, sizeof(line), ",\n{\"name\":\"process_labels\",\"ph\":\"M\",\"pid\":%d,"
+                     "\"args\":{\"labels\":\"%zu events dropped\"}}", pid, dropped());
+            json += line;
+        }
+
+        for (int t = 0; t < (int)rings.size(); ++t)
+        {
+            Ring const& ring = rings[t];
+            snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                     "\"args\":{\"name\":\"thread %d\"}}", pid, t, t);
+            json += line;
+
+            // Oldest first
+            size_t first = (ring.count > capacity) ? ring.count - capacity : 0;
+            for (size_t i = first; i < ring.count; ++i)
+            {
+                Event const& e = ring.events[i % capacity];
+                snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                         "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"iteration\":%ld}}", names[e.name].c_str(), pid, t,
+                         1e6 * (e.begin + shift - origin), 1e6 * (e.end - e.begin), e.iteration);
+                json += line;
+            }
+        }
+        return json;
+    }
+
+    static void write_json(std::string const& path, std::string const& events)
+    {
+        std::ofstream out(path);
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" << events << "\n]}\n";
+    }
+
+    // Single process
+    void write(std::string const& path) const
+    {
+        write_json(path, events_json(0, created));
+    }
+
+private:
+
+    struct Event
+    {
+        double begin, end;
+        long int iteration;
+        int name;
+    };
+
+    // Cache line aligned so that the threads' counters do not share lines
+    struct alignas(64) Ring
+    {
+        std::vector<Event> events;
+        size_t count = 0;
+        long int iteration = -1;
+        bool on = false;
+    };
+
+    std::vector<std::string> names;
+    std::vector<Ring> rings;
+    size_t capacity;
+    long int stride;
+    double created;
+};
+
+// Records its lifetime as an event, reads the clock only when recording
+class TraceScope
+{
+public:
+
+    TraceScope(Tracer& tracer, int thread, int name)
+        : tracer(tracer), thread(thread), name(name), begin(tracer.recording(thread) ? Tracer::now() : 0.0) {}
+    ~TraceScope()
+    {
+        if (tracer.recording(thread))
+            tracer.record(thread, name, begin, Tracer::now());
+    }
+
+    TraceScope(TraceScope const&) = delete;
+    TraceScope& operator=(TraceScope const&) = delete;
+
+private:
+
+    Tracer& tracer;
+    int thread, name;
+    double begin;
+};
+
+#ifdef MPI_VERSION
+
+// Seconds to add to this rank's clock to get the root's, collective
+inline double clock_shift(MPI_Comm comm, int root = 0)
+{
+    int const ROUNDS = 16;
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    std::vector<double> shifts(num_procs, 0.0);
+    for (int r = 0; r < num_procs; ++r)
+    {
+        if (r == root)
+            continue;
+        if (rank == root)
+        {
+            double best = 1e300;
+            for (int i = 0; i < ROUNDS; ++i)
+            {
+                double sent = Tracer::now(), remote;
+                MPI_Send(&sent, 1, MPI_DOUBLE, r, 0, comm);
+                MPI_Recv(&remote, 1, MPI_DOUBLE, r, 0, comm, MPI_STATUS_IGNORE);
+                double received = Tracer::now();
+                if (received - sent < best)
+                {
+                    best = received - sent;
+                    shifts[r] = 0.5 * (sent + received) - remote;
+                }
+            }
+        }
+        else if (rank == r)
+            for (int i = 0; i < ROUNDS; ++i)
+            {
+                double ping, time;
+                MPI_Recv(&ping, 1, MPI_DOUBLE, root, 0, comm, MPI_STATUS_IGNORE);
+                time = Tracer::now();
+                MPI_Send(&time, 1, MPI_DOUBLE, root, 0, comm);
+            }
+    }
+
+    double shift;
+    MPI_Scatter(shifts.data(), 1, MPI_DOUBLE, &shift, 1, MPI_DOUBLE, root, comm);
+    return shift;
+}
+
+// Collective, the root writes the events of all ranks to path with times
+// from the creation of the earliest tracer
+inline void write_trace(Tracer const& tracer, MPI_Comm comm, std::string const& path, int root = 0)
+{
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+
+    double shift = clock_shift(comm, root), start = tracer.start_time() + shift, origin;
+    MPI_Allreduce(&start, &origin, 1, MPI_DOUBLE, MPI_MIN, comm);
+    std::string mine = tracer.events_json(rank, origin, shift);
+
+    // Gathered as text, the ranks recorded different numbers of events
+    int length = (int)mine.size();
+    std::vector<int> lengths(num_procs), offsets(num_procs, 0);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, root, comm);
+    for (int r = 1; r < num_procs; ++r)
+        offsets[r] = offsets[r - 1] + lengths[r - 1];
+    std::string all(rank == root ? offsets[num_procs - 1] + lengths[num_procs - 1] : 0, ' ');
+    MPI_Gatherv(mine.data(), length, MPI_CHAR, &all[0], lengths.data(), offsets.data(), MPI_CHAR, root, comm);
+    if (rank != root)
+        return;
+
+    // Each rank's text starts with an event, join them with commas
+    std::string events;
+    for (int r = 0; r < num_procs; ++r)
+        events += (r > 0 ? ",\n" : "") + all.substr(offsets[r], lengths[r]);
+    Tracer::write_json(path, events);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,301 @@
+/*
+    Vectorized elementary functions on arrays of doubles.
+
+        vec_exp(x, y, n)         y_i = exp(x_i)
+        vec_sin(x, y, n)         y_i = sin(x_i)
+        vec_cos(x, y, n)         y_i = cos(x_i)
+        vec_sincos(x, s, c, n)   both, sharing the argument reduction
+        vec_sqrt(x, y, n)        y_i = sqrt(x_i), correctly rounded
+
+    libm evaluates one point per call with branches for every special case,
+    so a loop over exp(x[i]) runs at scalar speed.  Here each function is a
+    branch-free range reduction and polynomial written as an omp simd loop,
+    which the compiler turns into full-width vector code (build with
+    -march=native or at least -mavx2 -mfma to get 4 or 8 lanes).  That is
+    about 3 times faster than glibc for exp and 4 times for sincos.
+
+    The last argument of exp, sin, cos and sincos selects the accuracy.  The
+    bounds hold for normal results and |x| < 2^19, vmath_check in omp/
+    measures them against the long double libm (largest error seen on a few
+    million points in brackets):
+        VMATH_HA   high accuracy     1 ulp (exp 0.97, sin and cos 0.78), the
+                                     reduced argument of sin and cos carries
+                                     a second double of bits, 25% slower
+        VMATH_LA   low accuracy      3 ulp (exp 2.4, sin and cos 2.3), one
+                                     term fewer for exp and no compensation
+                                     in the reduction or in cos
+        VMATH_EP   enhanced perf.    exp 1e-8 relative (7e-9), sin and cos
+                                     2e-9 absolute (1.8e-9), for plots and
+                                     initial guesses
+    Signed zeros, infinities and NaN come out as from libm.  sqrt is always
+    correctly rounded; it only vectorizes with -fno-math-errno, without it
+    gcc keeps a branch to set errno for negative arguments.  exp underflows
+    to 0 below -745.13 and overflows to inf beyond 709.78.  sin and cos
+    reduce the argument with a three part pi / 2 (Cody and Waite), which
+    holds the accuracy for |x| < 2^19; larger arguments are handed to libm one
+    at a time.  The polynomials, and at HA the use of the low part of the
+    reduced argument, are those of fdlibm's __kernel_sin and __kernel_cos.
+
+    The functions are serial, call them on each thread's part of an array from
+    inside a parallel region.  exp and sqrt may write over their input, the
+    outputs of sin, cos and sincos must not overlap x.
+*/
+
+#ifndef VMATH_H
+#define VMATH_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <math.h>
+
+enum { VMATH_HA, VMATH_LA, VMATH_EP };
+
+namespace vmath_detail
+{
+    // Adding 1.5 * 2^52 to a double |v| < 2^51 rounds it to the nearest integer
+    // k and leaves k in the low bits of the mantissa.  Unlike floor() and
+    // casts to integer types this vectorizes everywhere.
+    double const SHIFTER = 6755399441055744.0;
+
+    inline double round_to_integer(double v)
+    {
+        return (v + SHIFTER) - SHIFTER;
+    }
+
+    inline int64_t as_bits(double v)
+    {
+        int64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+
+    inline double from_bits(int64_t bits)
+    {
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    // Limit v to [low, high] with bit masks, NaN stays NaN.  Written as a
+    // select the compiler turns this into branches, which stops the
+    // vectorizer for AVX2.
+    inline double clamp(double v, double low, double high)
+    {
+        int64_t below = -(int64_t)(v < low), above = -(int64_t)(v > high);
+        int64_t bits = (as_bits(v) & ~(below | above)) | (as_bits(low) & below) | (as_bits(high) & above);
+        return from_bits(bits);
+    }
+
+    // 2^k for an integer valued -1022 <= k <= 1023
+    inline double pow2(double k)
+    {
+        return from_bits(as_bits(k + (1023.0 + SHIFTER)) << 52);
+    }
+
+    double const LOG2E = 1.44269504088896338700e+00;
+    double const LN2_HI = 6.93147180369123816490e-01;   // 32 bits, k * LN2_HI is exact
+    double const LN2_LO = 1.90821492927058770002e-10;
+    double const MAX_EXP_X = 709.782712893383973096;
+    double const MIN_EXP_X = -745.133219101941108420;
+
+    // Taylor coefficients 1 / j! of exp
+    double const EXP_C[14] = {1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+                              1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800,
+                              1.0 / 479001600, 1.0 / 6227020800.0};
+
+    // EXP_C[J] + r (EXP_C[J + 1] + r (... + r EXP_C[DEGREE])), unrolled at
+    // compile time so the vectorizer sees straight line code
+    template <int J, int DEGREE>
+    struct ExpHorner
+    {
+        static double eval(double r) { return EXP_C[J] + r * ExpHorner<J + 1, DEGREE>::eval(r); }
+    };
+
+    template <int DEGREE>
+    struct ExpHorner<DEGREE, DEGREE>
+    {
+        static double eval(double) { return EXP_C[DEGREE]; }
+    };
+
+    // exp(x) = 2^k exp(r) with r = x - k ln 2 and |r| <= ln 2 / 2
+    template <int DEGREE>
+    inline double exp_point(double x)
+    {
+        // Just beyond the limits the scaling below overflows to inf or
+        // underflows to 0 by itself, NaN passes through the arithmetic
+        x = clamp(x, MIN_EXP_X - 1.0, MAX_EXP_X + 1.0);
+        double k = round_to_integer(x * LOG2E);
+        double r = (x - k * LN2_HI) - k * LN2_LO;
+
+        double p = 1.0 + (r + r * r * ExpHorner<2, DEGREE>::eval(r));
+
+        // 2^k in two factors so that k from -1077 to 1025 works
+        double k1 = round_to_integer(0.5 * k);
+        return p * pow2(k1) * pow2(k - k1);
+    }
+
+    template <int DEGREE>
+    inline void exp_kernel(const double* x, double* y, long int n)
+    {
+        #pragma omp simd
+        for (long int i = 0; i < n; ++i)
+            y[i] = exp_point<DEGREE>(x[i]);
+    }
+
+    double const TWO_OVER_PI = 6.36619772367581382433e-01;
+    // pi / 2 in three pieces of 33 bits each, fdlibm's pio2_1, pio2_2, pio2_3
+    double const PIO2_1 = 1.57079632673412561417e+00;
+    double const PIO2_2 = 6.07710050630396597660e-11;
+    double const PIO2_3 = 2.02226624871116645580e-21;
+    double const MAX_REDUCE = 524288.0;
+
+    double const S1 = -1.66666666666666324348e-01, S2 = 8.33333333332248946124e-03,
+                 S3 = -1.98412698298579493134e-04, S4 = 2.75573137070700676789e-06,
+                 S5 = -2.50507602534068634195e-08, S6 = 1.58969099521155010221e-10;
+    double const C1 = 4.16666666666666019037e-02, C2 = -1.38888888888741095749e-03,
+                 C3 = 2.48015872894767294178e-05, C4 = -2.75573143513906633035e-07,
+                 C5 = 2.08757232129817482790e-09, C6 = -1.13596475577881948265e-11;
+
+    enum { SIN = 1, COS = 2, SINCOS = 3 };
+
+    // sin(r) and cos(r) for x = k pi / 2 + r with |r| <= pi / 4, then the
+    // quadrant k mod 4 maps them to (sin x, cos x) = (s, c), (c, -s),
+    // (-s, -c) or (-c, s).  Only valid for |x| < MAX_REDUCE.
+    template <int ACCURACY>
+    inline void sincos_point(double x, double& sine, double& cosine)
+    {
+        double k = round_to_integer(x * TWO_OVER_PI);
+        int64_t quadrant = as_bits(k + SHIFTER);
+
+        double s, c;
+        double a = x - k * PIO2_1, b = k * PIO2_2;
+        if (ACCURACY == VMATH_HA)
+        {
+            // r + y = x - k pi / 2 to about 100 bits: x - k PIO2_1 and
+            // k PIO2_2 are exact, the rounding error of their difference
+            // is recovered (two sum) and goes into y with k PIO2_3
+            double t = a - b;
+            double b_virtual = t - a, a_virtual = t - b_virtual;
+            double lo = ((a - a_virtual) - (b + b_virtual)) - k * PIO2_3;
+            double r = t + lo;
+            double y = (t - r) + lo;
+
+            // fdlibm's __kernel_sin and __kernel_cos with the tail y
+            double z = r * r, v = z * r;
+            double p = S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)));
+            s = r - ((z * (0.5 * y - v * p) - y) - v * S1);
+            double t2 = z * z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+            double w = 1.0 - 0.5 * z;
+            c = w + (((1.0 - w) - 0.5 * z) + (t2 - r * y));
+        }
+        else
+        {
+            double r = a - b;
+            if (ACCURACY == VMATH_LA)
+                r -= k * PIO2_3;
+            double z = r * r;
+            if (ACCURACY == VMATH_EP)
+            {
+                s = r + r * z * (S1 + z * (S2 + z * (S3 + z * S4)));
+                c = 1.0 - 0.5 * z + z * z * (C1 + z * (C2 + z * (C3 + z * C4)));
+            }
+            else
+            {
+                s = r + r * z * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)))));
+                c = (1.0 - 0.5 * z) + z * z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+            }
+        }
+
+        // sin x = x once x * x underflows, which also keeps the sign of -0
+        int64_t tiny = -(int64_t)(x * x == 0.0);
+        s = from_bits((as_bits(s) & ~tiny) | (as_bits(x) & tiny));
+
+        // Swap and negate with bit masks, as selects on 64 bit integer
+        // conditions do not vectorize with AVX2
+        int64_t swap = -(quadrant & 1);
+        int64_t s_bits = as_bits(s), c_bits = as_bits(c);
+        sine = from_bits(((s_bits & ~swap) | (c_bits & swap)) ^ ((quadrant & 2) << 62));
+        cosine = from_bits(((c_bits & ~swap) | (s_bits & swap)) ^ (((quadrant + 1) & 2) << 62));
+    }
+
+    template <int ACCURACY, int WHICH>
+    inline void trig_kernel(const double* x, double* sines, double* cosines, long int n)
+    {
+        #pragma omp simd
+        for (long int i = 0; i < n; ++i)
+        {
+            double s, c;
+            sincos_point<ACCURACY>(x[i], s, c);
+            if (WHICH & SIN)
+                sines[i] = s;
+            if (WHICH & COS)
+                cosines[i] = c;
+        }
+
+        // Redo the points the reduction cannot handle with libm
+        int any_large = 0;
+        #pragma omp simd reduction(| : any_large)
+        for (long int i = 0; i < n; ++i)
+            any_large |= !(fabs(x[i]) < MAX_REDUCE);
+        if (any_large)
+        {
+            for (long int i = 0; i < n; ++i)
+            {
+                if (fabs(x[i]) < MAX_REDUCE)
+                    continue;
+                if (WHICH & SIN)
+                    sines[i] = sin(x[i]);
+                if (WHICH & COS)
+                    cosines[i] = cos(x[i]);
+            }
+        }
+    }
+
+    template <int WHICH>
+    inline void trig(const double* x, double* sines, double* cosines, long int n, int accuracy)
+    {
+        if (accuracy == VMATH_HA)
+            trig_kernel<VMATH_HA, WHICH>(x, sines, cosines, n);
+        else if (accuracy == VMATH_LA)
+            trig_kernel<VMATH_LA, WHICH>(x, sines, cosines, n);
+        else
+            trig_kernel<VMATH_EP, WHICH>(x, sines, cosines, n);
+    }
+}
+
+inline void vec_exp(const double* x, double* y, long int n, int accuracy = VMATH_HA)
+{
+    using namespace vmath_detail;
+
+    if (accuracy == VMATH_HA)
+        exp_kernel<13>(x, y, n);
+    else if (accuracy == VMATH_LA)
+        exp_kernel<12>(x, y, n);
+    else
+        exp_kernel<7>(x, y, n);
+}
+
+inline void vec_sincos(const double* x, double* s, double* c, long int n, int accuracy = VMATH_HA)
+{
+    vmath_detail::trig<vmath_detail::SINCOS>(x, s, c, n, accuracy);
+}
+
+inline void vec_sin(const double* x, double* y, long int n, int accuracy = VMATH_HA)
+{
+    vmath_detail::trig<vmath_detail::SIN>(x, y, NULL, n, accuracy);
+}
+
+inline void vec_cos(const double* x, double* y, long int n, int accuracy = VMATH_HA)
+{
+    vmath_detail::trig<vmath_detail::COS>(x, NULL, y, n, accuracy);
+}
+
+inline void vec_sqrt(const double* x, double* y, long int n)
+{
+    #pragma omp simd
+    for (long int i = 0; i < n; ++i)
+        y[i] = sqrt(x[i]);
+}
+
+#endif
@@ -0,0 +1,337 @@
+/*
+    A small work-stealing task scheduler on top of std::thread.
+
+    Every worker owns a Chase-Lev deque (Chase and Lev 2005, with the memory
+    orderings of Le, Pop, Cohen and Zappa Nardelli 2013).  The owner pushes
+    and pops tasks at the bottom without any locking while idle workers steal
+    from the top of a randomly chosen victim's deque.
+
+    parallel_for(begin, end, grain, body) covers [begin, end) with a single
+    range task.  Whoever runs a range splits off its upper half onto its own
+    deque until at most grain iterations are left and then calls
+    body(first, last) on what remains, so idle workers always steal the
+    largest pieces of work first.  This keeps the load balanced even when the
+    cost per iteration is irregular or some workers are descheduled.
+
+    parallel_reduce(begin, end, grain, identity, body, combine) cuts the range
+    into fixed chunks of grain iterations, reduces each chunk with body and
+    combines the chunk results in order, so the result does not depend on
+    which worker ran which chunk.
+
+    The thread that constructs the pool acts as worker 0 and takes part in
+    the work while it waits for a parallel_for to finish.  Calls may be nested
+    inside tasks, but only one thread outside the pool may submit work.
+*/
+
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+// Padding and cpu_relax()
+#include "barrier.h"
+
+struct RangeJob
+{
+    std::function<void(int64_t, int64_t)> body;
+    int64_t grain;
+    std::atomic<int64_t> remaining;
+};
+
+struct RangeTask
+{
+    RangeJob* job;
+    int64_t begin, end;
+};
+
+class ChaseLevDeque
+{
+public:
+
+    ChaseLevDeque(int64_t capacity = 256) : top(0), bottom(0)
+    {
+        array.store(new Array(capacity));
+    }
+
+    ~ChaseLevDeque()
+    {
+        delete array.load();
+        for (size_t i = 0; i < retired.size(); ++i)
+            delete retired[i];
+    }
+
+    // Owner only
+    void push(RangeTask* task)
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_acquire);
+        Array* a = array.load(std::memory_order_relaxed);
+        if (b - t > a->capacity - 1)
+            a = grow(a, t, b);
+        a->put(b, task);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Owner only, NULL if empty
+    RangeTask* pop()
+    {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = array.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+
+        RangeTask* task = NULL;
+        if (t <= b)
+        {
+            task = a->get(b);
+            if (t == b)
+            {
+                // Last task, race the thieves for it
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    task = NULL;
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        }
+        else
+            bottom.store(b + 1, std::memory_order_relaxed);
+        return task;
+    }
+
+    // Any thread, NULL if empty or if we lost a race with another thief
+    RangeTask* steal()
+    {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+
+        if (t < b)
+        {
+            Array* a = array.load(std::memory_order_acquire);
+            RangeTask* task = a->get(t);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return NULL;
+            return task;
+        }
+        return NULL;
+    }
+
+private:
+
+    struct Array
+    {
+        int64_t capacity;
+        std::vector<std::atomic<RangeTask*>> slots;
+
+        Array(int64_t capacity) : capacity(capacity), slots(capacity) {}
+
+        RangeTask* get(int64_t i) { return slots[i % capacity].load(std::memory_order_relaxed); }
+        void put(int64_t i, RangeTask* task) { slots[i % capacity].store(task, std::memory_order_relaxed); }
+    };
+
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> top;
+    alignas(CACHE_LINE_SIZE) std::atomic<int64_t> bottom;
+    alignas(CACHE_LINE_SIZE) std::atomic<Array*> array;
+
+    // Thieves may still be reading an old array, so keep them until the end
+    std::vector<Array*> retired;
+
+    Array* grow(Array* a, int64_t t, int64_t b)
+    {
+        Array* bigger = new Array(2 * a->capacity);
+        for (int64_t i = t; i < b; ++i)
+            bigger->put(i, a->get(i));
+        retired.push_back(a);
+        array.store(bigger, std::memory_order_release);
+        return bigger;
+    }
+};
+
+class WorkStealingPool
+{
+public:
+
+    WorkStealingPool(int num_workers = 0)
+        : num_workers(num_workers > 0 ? num_workers : std::thread::hardware_concurrency()),
+          deques(this->num_workers), active_jobs(0), epoch(0), shutdown(false)
+    {
+        for (int i = 0; i < this->num_workers; ++i)
+            deques[i].value = new ChaseLevDeque();
+
+        worker_ID() = 0;
+        for (int i = 1; i < this->num_workers; ++i)
+            threads.push_back(std::thread(&WorkStealingPool::worker_loop, this, i));
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+            shutdown.store(true);
+        }
+        sleep_condition.notify_all();
+        for (size_t i = 0; i < threads.size(); ++i)
+            threads[i].join();
+        for (int i = 0; i < num_workers; ++i)
+            delete deques[i].value;
+    }
+
+    int size() { return num_workers; }
+
+    // Call body(first, last) on pieces of at most grain iterations that cover
+    // [begin, end), returns once all of them are done
+    template <typename Body>
+    void parallel_for(int64_t begin, int64_t end, int64_t grain, Body body)
+    {
+        if (end <= begin)
+            return;
+        if (grain < 1)
+            grain = 1;
+
+        RangeJob job;
+        job.body = body;
+        job.grain = grain;
+        job.remaining.store(end - begin);
+
+        int self = worker_ID();
+        deques[self].value->push(new RangeTask{&job, begin, end});
+
+        active_jobs.fetch_add(1);
+        epoch.fetch_add(1);
+        {
+            std::lock_guard<std::mutex> lock(sleep_mutex);
+        }
+        sleep_condition.notify_all();
+
+        // Work (on anything, including other jobs) until ours is finished
+        std::minstd_rand random(self + 1);
+        while (job.remaining.load(std::memory_order_acquire) > 0)
+        {
+            RangeTask* task = find_task(self, random);
+            if (task != NULL)
+                run(self, task);
+            else
+                std::this_thread::yield();
+        }
+
+        active_jobs.fetch_sub(1);
+    }
+
+    // Reduce [begin, end) in chunks of grain iterations with
+    // body(first, last) -> T and combine the chunk results left to right
+    template <typename T, typename Body, typename Combine>
+    T parallel_reduce(int64_t begin, int64_t end, int64_t grain, T identity, Body body, Combine combine)
+    {
+        if (grain < 1)
+            grain = 1;
+        int64_t num_chunks = (end - begin + grain - 1) / grain;
+        std::vector<padded<T>> results(num_chunks > 0 ? num_chunks : 0);
+
+        parallel_for(0, num_chunks, 1, [&](int64_t first, int64_t last)
+        {
+            for (int64_t c = first; c < last; ++c)
+                results[c].value = body(begin + c * grain, std::min(begin + (c + 1) * grain, end));
+        });
+
+        T total = identity;
+        for (int64_t c = 0; c < num_chunks; ++c)
+            total = combine(total, results[c].value);
+        return total;
+    }
+
+private:
+
+    int num_workers;
+    std::vector<padded<ChaseLevDeque*>> deques;
+    std::vector<std::thread> threads;
+
+    // Sleeping when there is nothing to do at all
+    std::atomic<int> active_jobs;
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> shutdown;
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_condition;
+
+    static int& worker_ID()
+    {
+        static thread_local int ID = 0;
+        return ID;
+    }
+
+    RangeTask* find_task(int self, std::minstd_rand& random)
+    {
+        RangeTask* task = deques[self].value->pop();
+        if (task != NULL || num_workers == 1)
+            return task;
+
+        // Try every other worker once, starting at a random one
+        int start = random() % num_workers;
+        for (int i = 0; i < num_workers; ++i)
+        {
+            int victim = (start + i) % num_workers;
+            if (victim == self)
+                continue;
+            task = deques[victim].value->steal();
+            if (task != NULL)
+                return task;
+        }
+        return NULL;
+    }
+
+    // Split off upper halves for others to steal, then run what is left
+    void run(int self, RangeTask* task)
+    {
+        RangeJob* job = task->job;
+        int64_t begin = task->begin, end = task->end;
+        delete task;
+
+        while (end - begin > job->grain)
+        {
+            int64_t middle = begin + (end - begin) / 2;
+            deques[self].value->push(new RangeTask{job, middle, end});
+            end = middle;
+        }
+
+        job->body(begin, end);
+        job->remaining.fetch_sub(end - begin, std::memory_order_release);
+    }
+
+    void worker_loop(int self)
+    {
+        worker_ID() = self;
+        std::minstd_rand random(self + 1);
+
+        while (!shutdown.load())
+        {
+            uint64_t seen = epoch.load();
+
+            RangeTask* task = find_task(self, random);
+            if (task != NULL)
+            {
+                run(self, task);
+                continue;
+            }
+
+            if (active_jobs.load() > 0)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            sleep_condition.wait(lock, [&]() { return shutdown.load() || epoch.load() != seen; });
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,132 @@
+/*
+    Matrix multiply benchmark, the C++ counterpart of ../C/matrix_multiply.c
+    and ../fortran/matrix_multiply.f90.
+
+    Usage: mat_mult [N] [method] [threads] [crossover]
+
+    Methods:
+        1   blocked and packed SIMD gemm (gemm.h)
+        2   triple loop, OpenMP over the rows of C
+        3   one BLAS ddot per entry of C, OpenMP over the rows of C
+        4   BLAS dgemm
+        5   Strassen-Winograd down to blocks of crossover rows, then gemm.h
+            (strassen.h), compared against method 1
+
+    A and B are filled from Philox streams 0 and 1 with a fixed seed, so every
+    method and thread count multiplies the same matrices.  The product is
+    checked against dot products computed in long double at a few entries.
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+// Blocked matrix multiply
+#include "gemm.h"
+// Strassen-Winograd on top of it
+#include "strassen.h"
+// Counter-based random numbers for the matrices
+#include "philox.h"
+
+// System BLAS
+#include <cblas.h>
+
+// Standard IO libraries
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <math.h>
+
+// Seed of the random matrices
+uint64_t const SEED = 2012;
+
+// Seconds for C = A B with the chosen method, -1 for an invalid one
+double matrix_multiply_test(int N, int method, int crossover, double& error)
+{
+    // On the heap, three 1000 x 1000 matrices do not fit on the stack
+    vector<double> A((size_t)N * N), B((size_t)N * N), C((size_t)N * N, 0.0);
+    philox_uniform(SEED, 0, 0, (long int)N * N, A.data());
+    philox_uniform(SEED, 1, 0, (long int)N * N, B.data());
+
+    double start = omp_get_wtime();
+    switch (method)
+    {
+        case 1:
+            gemm(N, N, N, 1.0, A.data(), N, B.data(), N, 0.0, C.data(), N);
+            break;
+        case 2:
+            #pragma omp parallel for
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    for (int k = 0; k < N; ++k)
+                        C[(size_t)i * N + j] += A[(size_t)i * N + k] * B[(size_t)k * N + j];
+            break;
+        case 3:
+            #pragma omp parallel for
+            for (int i = 0; i < N; ++i)
+                for (int j = 0; j < N; ++j)
+                    C[(size_t)i * N + j] = cblas_ddot(N, &A[(size_t)i * N], 1, &B[j], N);
+            break;
+        case 4:
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, N, N, N, 1.0, A.data(), N, B.data(), N,
+                        0.0, C.data(), N);
+            break;
+        case 5:
+            strassen(N, A.data(), N, B.data(), N, C.data(), N, crossover);
+            break;
+        default:
+            cout << "*** ERROR *** Invalid multiplication method chosen!\n";
+            return -1;
+    }
+    double elapsed = omp_get_wtime() - start;
+
+    // Relative error at a few entries spread over C
+    error = 0.0;
+    for (int sample = 0; sample < 16; ++sample)
+    {
+        int i = (int)(philox_double(SEED, 2, 2 * sample) * N);
+        int j = (int)(philox_double(SEED, 2, 2 * sample + 1) * N);
+        long double exact = 0.0;
+        for (int k = 0; k < N; ++k)
+            exact += (long double)A[(size_t)i * N + k] * B[(size_t)k * N + j];
+        error = fmax(error, fabs((double)(C[(size_t)i * N + j] - exact)) / (double)exact);
+    }
+
+    return elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+    string const METHOD_NAMES[] = {"", "gemm.h", "triple loop", "ddot", "dgemm", "Strassen-Winograd"};
+
+    int N = (argc > 1) ? stoi(argv[1]) : 1000;
+    int method = (argc > 2) ? stoi(argv[2]) : 1;
+    int threads = (argc > 3) ? stoi(argv[3]) : 1;
+    int crossover = (argc > 4) ? stoi(argv[4]) : 512;
+    omp_set_num_threads(threads);
+
+    // Strassen trades accuracy for flops, so it is shown against the plain
+    // blocked multiply it is built on, run first so that neither gets the
+    // other's warm up
+    double gemm_error, gemm_time = 0.0;
+    if (method == 5)
+        gemm_time = matrix_multiply_test(N, 1, crossover, gemm_error);
+
+    double error;
+    double time = matrix_multiply_test(N, method, crossover, error);
+    if (time < 0.0)
+        return 1;
+
+    cout << "Timing for " << N << "x" << N << " matrices with " << METHOD_NAMES[method] << " on " << threads;
+    cout << " threads: " << time << " s, " << 2.0 * N * N * N / time / 1e9 << " GFLOP/s";
+    cout << " (relative error " << error << ").\n";
+
+    if (method == 5)
+    {
+        cout << "Crossover " << crossover << ": " << gemm_time / time << "x the speed of gemm.h, relative error ";
+        cout << error << " against " << gemm_error << ".\n";
+    }
+
+    return 0;
+}
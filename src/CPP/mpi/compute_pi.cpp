@@ -1,21 +1,297 @@
+/*
+    Compute pi as the integral of 4 / (1 + x^2) over [0, 1].
+
+    Usage: compute_pi [-n intervals] [-r rule] [-l levels] [-t threads] [-s naive|repro] [-k seed]
+                      [-d static|dynamic|compare] [-c min_chunk] [-x slowdown]
+
+        -n   number of panels or samples, 64 bit (default 2^20)
+        -r   midpoint, simpson, gauss2, gauss3, gauss4, gauss5 or montecarlo
+        -l   Richardson extrapolation over n, 2n, ..., 2^(levels - 1) n
+             panels (default 1, no extrapolation)
+        -t   OpenMP threads per rank (default OMP_NUM_THREADS)
+        -s   sum the panels in plain double precision or reproducibly, so
+             that the result does not depend on ranks and threads
+        -k   seed of the Monte Carlo samples (default 2012)
+        -d   how the panels are given to the ranks, compare runs static and
+             then dynamic
+        -c   smallest dynamic chunk (default 2^16 panels or samples)
+        -x   make the last rank this many times slower (default 1)
+
+    With the static schedule the panels of every level are split evenly over
+    the ranks.  With the dynamic one they are cut into guided chunks, each a
+    fraction 1 / (2 ranks) of what is left but at least min_chunk, and ranks
+    take the next chunk number with MPI_Fetch_and_op on a counter in rank 0's
+    window.  Nobody has to answer requests, the atomics are done by the MPI
+    library (or the network), and rank 0 computes like everyone else; as the
+    chunks shrink geometrically there are only O(ranks log n) of them.  Every
+    rank splits its panels over its threads.
+
+    -x imitates an older node: the last rank sleeps after every piece of work
+    so that the piece takes slowdown times as long.  Each run reports how
+    long the busiest rank worked against the average, and compare reports the
+    speedup of the dynamic schedule.  Rank 0 also times one core's share by
+    itself, which gives the parallel efficiency.
+
+    montecarlo averages the integrand over n uniform samples instead, with
+    the standard error from the sample variance.  Sample i is the number at
+    position i of the seed's Philox stream 0, so the samples are the same for
+    any number of ranks and threads, and with -s repro so are the last bits
+    of the result, for both schedules.
+*/
+
 // MPI Library
 #include "mpi.h"
+// OpenMP library header
+#include <omp.h>
+
+// Binned accumulators and their MPI_Op, after mpi.h
+#include "reproducible_sum.h"
+// Vectorized composite quadrature rules
+#include "quadrature.h"
+// Counter-based random numbers for the Monte Carlo samples
+#include "philox.h"
 
 // Standard IO libraries
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <vector>
 using namespace std;
 
+// usleep() for the slow rank
+#include <unistd.h>
+
 #include <math.h>
 
+// No branches and no pow(), so the panel loops vectorize
+struct PiIntegrand
+{
+    double operator()(double x) const { return 4.0 / (1.0 + x * x); }
+};
+
+int const MONTE_CARLO = QUAD_GAUSS5 + 1;
+
+// Samples and reproducible terms are computed a block at a time
+int const BLOCK = 1024;
+
+// Everything that defines the computation, the same on all ranks
+struct Problem
+{
+    int64_t num_intervals, min_chunk;
+    int rule, levels, num_threads;
+    bool reproducible;
+    uint64_t seed;
+    double slowdown;
+};
+
+// Sum of f and of f^2 over the samples [first, last) of (seed, stream 0)
+template <typename F>
+double monte_carlo_sum(const F& f, uint64_t seed, int64_t first, int64_t last, int num_threads, double& sum_squares)
+{
+    double sum = 0.0;
+    sum_squares = 0.0;
+    #pragma omp parallel for schedule(static) reduction(+ : sum, sum_squares) num_threads(num_threads)
+    for (int64_t block_start = first; block_start < last; block_start += BLOCK)
+    {
+        double x[BLOCK];
+        long int length = min((int64_t)BLOCK, last - block_start);
+        philox_uniform(seed, 0, block_start, length, x);
+        #pragma omp simd reduction(+ : sum, sum_squares)
+        for (long int j = 0; j < length; ++j)
+        {
+            double y = f(x[j]);
+            sum += y;
+            sum_squares += y * y;
+        }
+    }
+    return sum;
+}
+
+// Add the panels [first, last) of level l to sum l, or for Monte Carlo the
+// samples [first, last) to sums 0 (f) and 1 (f^2).  Plain sums go to naive,
+// reproducible ones to binned.
+void accumulate(const Problem& p, int l, int64_t first, int64_t last,
+                vector<double>& naive, vector<ReproducibleSum>& binned)
+{
+    PiIntegrand f;
+    if (p.rule == MONTE_CARLO && !p.reproducible)
+    {
+        double sum_squares;
+        naive[0] += monte_carlo_sum(f, p.seed, first, last, p.num_threads, sum_squares);
+        naive[1] += sum_squares;
+    }
+    else if (p.rule == MONTE_CARLO)
+    {
+        ReproducibleSum total, total_squares;
+        #pragma omp parallel for schedule(static) reduction(reproducible_sum : total, total_squares)
+        for (int64_t block_start = first; block_start < last; block_start += BLOCK)
+        {
+            double y[BLOCK], y_squared[BLOCK];
+            long int length = min((int64_t)BLOCK, last - block_start);
+            philox_uniform(p.seed, 0, block_start, length, y);
+            #pragma omp simd
+            for (long int j = 0; j < length; ++j)
+            {
+                y[j] = f(y[j]);
+                y_squared[j] = y[j] * y[j];
+            }
+            total.add(y, length);
+            total_squares.add(y_squared, length);
+        }
+        binned[0].add(total);
+        binned[1].add(total_squares);
+    }
+    else if (!p.reproducible)
+    {
+        int64_t n = p.num_intervals << l;
+        naive[l] += quadrature_sum(f, p.rule, 0.0, 1.0 / n, first, last, p.num_threads);
+    }
+    else
+    {
+        // Same terms, summed in blocks into accumulators that merge exactly
+        int64_t n = p.num_intervals << l;
+        ReproducibleSum total;
+        #pragma omp parallel for schedule(static) reduction(reproducible_sum : total)
+        for (int64_t block_start = first; block_start < last; block_start += BLOCK)
+        {
+            double terms[BLOCK];
+            long int length = min((int64_t)BLOCK, last - block_start);
+            quadrature_terms(f, p.rule, 0.0, 1.0 / n, block_start, length, terms);
+            total.add(terms, length);
+        }
+        binned[l].add(total);
+    }
+}
+
+// This rank's share [first, last) of n panels
+void split(int64_t n, int num_procs, int rank, int64_t& first, int64_t& last)
+{
+    int64_t base = n / num_procs, extra = n % num_procs;
+    first = rank * base + min((int64_t)rank, extra);
+    last = first + base + (rank < extra ? 1 : 0);
+}
+
+// Chunk c of n panels is [bounds[c], bounds[c + 1]), big chunks first and
+// smaller ones towards the end so that the ranks finish close together
+vector<int64_t> guided_chunks(int64_t n, int num_procs, int64_t min_chunk)
+{
+    vector<int64_t> bounds(1, 0);
+    while (bounds.back() < n)
+    {
+        int64_t left = n - bounds.back();
+        bounds.push_back(bounds.back() + min(left, max(min_chunk, left / (2 * num_procs))));
+    }
+    return bounds;
+}
+
+// One complete computation.  Returns the wall time, sums gets the summed
+// levels (or f and f^2) on rank 0.
+double run(const Problem& p, bool dynamic, int rank, int num_procs, vector<double>& sums)
+{
+    int num_sums = (p.rule == MONTE_CARLO) ? 2 : p.levels;
+    vector<double> naive(num_sums, 0.0);
+    vector<ReproducibleSum> binned(num_sums);
+    double busy = 0.0;
+    int64_t chunks = 0;
+
+    // Work on a range, stretched on the slow rank
+    auto work = [&](int l, int64_t first, int64_t last)
+    {
+        double start = MPI_Wtime();
+        accumulate(p, l, first, last, naive, binned);
+        if (rank == num_procs - 1 && p.slowdown > 1.0)
+            usleep((useconds_t)((p.slowdown - 1.0) * (MPI_Wtime() - start) * 1e6));
+        busy += MPI_Wtime() - start;
+        chunks++;
+    };
+
+    MPI_Win window;
+    int64_t* counters;
+    if (dynamic)
+    {
+        // One chunk counter per level on rank 0
+        MPI_Win_allocate((rank == 0 ? p.levels : 0) * sizeof(int64_t), sizeof(int64_t), MPI_INFO_NULL,
+                         MPI_COMM_WORLD, &counters, &window);
+        if (rank == 0)
+        {
+            MPI_Win_lock(MPI_LOCK_EXCLUSIVE, 0, 0, window);
+            for (int l = 0; l < p.levels; ++l)
+                counters[l] = 0;
+            MPI_Win_unlock(0, window);
+        }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    if (!dynamic)
+    {
+        for (int l = 0; l < p.levels; ++l)
+        {
+            int64_t first, last;
+            split(p.num_intervals << l, num_procs, rank, first, last);
+            work(l, first, last);
+        }
+    }
+    else
+    {
+        MPI_Win_lock_all(0, window);
+        for (int l = 0; l < p.levels; ++l)
+        {
+            vector<int64_t> bounds = guided_chunks(p.num_intervals << l, num_procs, p.min_chunk);
+            int64_t const one = 1;
+            int64_t chunk;
+            while (true)
+            {
+                MPI_Fetch_and_op(&one, &chunk, MPI_INT64_T, 0, l, MPI_SUM, window);
+                MPI_Win_flush(0, window);
+                if (chunk >= (int64_t)bounds.size() - 1)
+                    break;
+                work(l, bounds[chunk], bounds[chunk + 1]);
+            }
+        }
+        MPI_Win_unlock_all(window);
+    }
+
+    sums.assign(num_sums, 0.0);
+    if (!p.reproducible)
+        MPI_Reduce(naive.data(), sums.data(), num_sums, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    else
+    {
+        vector<ReproducibleSum> total(num_sums);
+        MPI_Reduce(binned.data(), total.data(), num_sums, reproducible_sum_mpi_type(),
+                   reproducible_sum_mpi_op(), 0, MPI_COMM_WORLD);
+        for (int k = 0; k < num_sums; ++k)
+            sums[k] = total[k].value();
+    }
+    double elapsed = MPI_Wtime() - start_time;
+
+    if (dynamic)
+        MPI_Win_free(&window);
+
+    // Load balance: the busiest rank against the average
+    double busy_max, busy_sum;
+    int64_t chunks_min, chunks_max;
+    MPI_Reduce(&busy, &busy_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&busy, &busy_sum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&chunks, &chunks_min, 1, MPI_INT64_T, MPI_MIN, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&chunks, &chunks_max, 1, MPI_INT64_T, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0)
+    {
+        cout << (dynamic ? "Dynamic" : "Static") << " schedule took " << elapsed << " s, busiest rank ";
+        cout << busy_max << " s against " << busy_sum / num_procs << " s on average (imbalance ";
+        cout << 100.0 * (busy_max * num_procs / busy_sum - 1.0) << "%), " << chunks_min << " to " << chunks_max;
+        cout << " chunks per rank.\n";
+    }
+
+    return elapsed;
+}
+
 int main(int argc, char* argv[])
 {
-    int num_procs, rank, tag;
-    MPI_Status status;
+    int num_procs, rank;
 
     double const pi = 3.1415926535897932384626433832795;
-    
-    int num_points, points_per_proc, start_index, end_index;
-    double x, dx, pi_sum, pi_sum_proc, difference;
+    string const RULE_NAMES[] = {"midpoint", "simpson", "gauss2", "gauss3", "gauss4", "gauss5", "montecarlo"};
 
     // Initialize MPI
     MPI_Init(&argc, &argv);
@@ -24,49 +300,136 @@ int main(int argc, char* argv[])
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
-    // Rank 0 will ask for number of points
-    if (rank == 0)
+    // Every rank reads the same command line
+    Problem p;
+    p.num_intervals = (int64_t)1 << 20;
+    p.min_chunk = (int64_t)1 << 16;
+    p.rule = QUAD_MIDPOINT;
+    p.levels = 1;
+    p.num_threads = omp_get_max_threads();
+    p.reproducible = false;
+    p.seed = 2012;
+    p.slowdown = 1.0;
+    string schedule = "static";
+    for (int i = 1; i + 1 < argc; i += 2)
     {
-        cout << "How many points to use?\n";
-        cin >> num_points;
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "-n")
+            p.num_intervals = stoll(value);
+        else if (flag == "-r")
+            p.rule = find(RULE_NAMES, RULE_NAMES + 7, value) - RULE_NAMES;
+        else if (flag == "-l")
+            p.levels = max(1, stoi(value));
+        else if (flag == "-t")
+            p.num_threads = max(1, stoi(value));
+        else if (flag == "-s")
+            p.reproducible = (value == "repro");
+        else if (flag == "-k")
+            p.seed = stoull(value);
+        else if (flag == "-d")
+            schedule = value;
+        else if (flag == "-c")
+            p.min_chunk = max((int64_t)1, (int64_t)stoll(value));
+        else if (flag == "-x")
+            p.slowdown = stod(value);
     }
-    // Broadcast the number of points
-    MPI_Bcast(&num_points, 1, MPI_INTEGER, 0, MPI_COMM_WORLD);
-
-    dx = 1.0 / (double)num_points;
+    if (p.rule > MONTE_CARLO || p.num_intervals < 1
+        || (schedule != "static" && schedule != "dynamic" && schedule != "compare"))
+    {
+        if (rank == 0)
+        {
+            cout << "Usage: compute_pi [-n intervals] [-r rule] [-l levels] [-t threads] [-s naive|repro] [-k seed]\n";
+            cout << "                  [-d static|dynamic|compare] [-c min_chunk] [-x slowdown]\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
+    if (p.rule == MONTE_CARLO)
+        p.levels = 1;
+    omp_set_num_threads(p.num_threads);
 
-    // Determine how many points to handle with each proc
-    points_per_proc = (num_points + num_procs - 1) / num_procs;
-    // Only print out the number of points per proc by rank 0
     if (rank == 0)
-        cout << "Points per proc = " << points_per_proc << "\n.";
-
-    // Determine start and end indices for this rank's points
-    start_index = rank * points_per_proc;
-    end_index = (int)fmin((rank + 1) * points_per_proc, num_points) - 1;
-
-    // Diagnostic - Print the intervals handled by each rank
-    cout << "Rank " << rank << " - (" << start_index << ", " << end_index << ")\n";
-
-    pi_sum_proc = 0.0;
-    for (int i = start_index; i <= end_index; ++i)
     {
-        x = (i - 0.5) * dx;
-        pi_sum_proc += 1.0 / (1.0 + pow(x, 2));
+        cout << "Rule " << RULE_NAMES[p.rule] << " on " << p.num_intervals;
+        if (p.rule == MONTE_CARLO)
+            cout << " samples, ";
+        else
+            cout << " intervals, " << p.levels << " level(s), ";
+        cout << num_procs << " ranks x " << p.num_threads << " threads";
+        if (p.slowdown > 1.0)
+            cout << ", rank " << num_procs - 1 << " " << p.slowdown << " times slower";
+        cout << ".\n";
     }
 
-    MPI_Reduce(&pi_sum_proc, &pi_sum, 1, MPI_DOUBLE_PRECISION, MPI_SUM, 0, 
-                MPI_COMM_WORLD);
+    vector<double> estimates;
+    double elapsed;
+    if (schedule == "compare")
+    {
+        double static_time = run(p, false, rank, num_procs, estimates);
+        elapsed = run(p, true, rank, num_procs, estimates);
+        if (rank == 0)
+            cout << "Speedup of the dynamic schedule over the static split " << static_time / elapsed << ".\n";
+    }
+    else
+        elapsed = run(p, schedule == "dynamic", rank, num_procs, estimates);
 
     if (rank == 0)
     {
-        pi_sum *= 4.0 * dx;
-        difference = fabs(pi - pi_sum);
+        PiIntegrand f;
+        double pi_sum;
+        int64_t num_evaluations = 0;
+        if (p.rule == MONTE_CARLO)
+        {
+            double n = (double)p.num_intervals;
+            pi_sum = estimates[0] / n;
+            double variance = max(estimates[1] / n - pi_sum * pi_sum, 0.0);
+            cout << "  " << p.num_intervals << " samples with seed " << p.seed << ": standard error ";
+            cout << sqrt(variance / n) << ", error " << pi_sum - pi << "\n";
+            num_evaluations = p.num_intervals;
+        }
+        else
+        {
+            for (int l = 0; l < p.levels; ++l)
+            {
+                int64_t n = p.num_intervals << l;
+                estimates[l] = (estimates[l] + quadrature_end_correction(f, p.rule, 0.0, 1.0)) / n;
+                cout << "  " << n << " intervals: " << estimates[l] << ", error " << estimates[l] - pi << "\n";
+                num_evaluations += n * quadrature_nodes(p.rule);
+            }
+            pi_sum = richardson(estimates.data(), p.levels, quadrature_order(p.rule));
+        }
+
+        cout.precision(17);
         cout << "The approximation to pi is " << pi_sum << ".\n";
-        cout << "Difference = " << difference << ".\n";
+        cout.precision(6);
+        cout << "Difference = " << fabs(pi - pi_sum) << ".\n";
+        cout << "Sum " << (p.reproducible ? "(repro)" : "(naive)") << " = " << hexfloat << pi_sum;
+        cout << defaultfloat << ", took " << elapsed << " s on rank 0.\n";
+
+        // One core's share of the first level by itself, for the efficiency
+        int64_t n = p.num_intervals;
+        int64_t share = max(min(n / (num_procs * p.num_threads), (int64_t)1 << 26), (int64_t)1);
+        double serial_time = MPI_Wtime(), serial_rate;
+        volatile double serial_sum;
+        if (p.rule == MONTE_CARLO)
+        {
+            double sum_squares;
+            serial_sum = monte_carlo_sum(f, p.seed, 0, share, 1, sum_squares);
+            serial_rate = share / (MPI_Wtime() - serial_time);
+        }
+        else
+        {
+            serial_sum = quadrature_sum(f, p.rule, 0.0, 1.0 / n, 0, share, 1);
+            serial_rate = share * quadrature_nodes(p.rule) / (MPI_Wtime() - serial_time);
+        }
+
+        int num_cores = num_procs * p.num_threads;
+        double rate = num_evaluations / elapsed;
+        cout << num_evaluations << " evaluations, " << rate / num_cores / 1e6 << " Mpoints/s per core against ";
+        cout << serial_rate / 1e6 << " on one core, parallel efficiency " << 100.0 * rate / (num_cores * serial_rate) << "%.\n";
     }
 
     MPI_Finalize();
-    
+
     return 0;
 }
@@ -1,8 +1,30 @@
+/*
+    Hello from every rank, and where each rank and its threads run.
+
+    Usage: hello_world [layout.csv]
+
+    Every OpenMP thread of every rank (one thread unless OMP_NUM_THREADS is
+    set) reports its host, CPU, core, socket, NUMA node, L3 cache and
+    allowed CPUs.  Rank 0 gathers them into one table, warns about CPUs and
+    cores that are shared and about workers that are not pinned, and with an
+    argument writes the layout as CSV in the format of topology.h.  Try
+    mpirun --bind-to core --map-by socket.
+*/
+
 // MPI Library
 #include "mpi.h"
 
+// OpenMP library header
+#include <omp.h>
+
+// Core, socket, NUMA node and cache of every rank and thread
+#include "topology.h"
+
 // Standard IO libraries
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 using namespace std;
 
 int main(int argc, char* argv[])
@@ -18,7 +40,48 @@ int main(int argc, char* argv[])
 
     cout << "Hello world from process " << rank << " of " << num_procs << ".\n";
 
+    // The layout lines of this rank's threads
+    vector<string> lines(omp_get_max_threads());
+    #pragma omp parallel
+    lines[omp_get_thread_num()] = layout_line(current_placement(rank, omp_get_thread_num())) + "\n";
+    string mine;
+    for (string const& line : lines)
+        mine += line;
+
+    // Gathered as text, ranks may have different numbers of threads
+    int length = (int)mine.size();
+    vector<int> lengths(num_procs), offsets(num_procs, 0);
+    MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    for (int r = 1; r < num_procs; ++r)
+        offsets[r] = offsets[r - 1] + lengths[r - 1];
+    string all(rank == 0 ? offsets[num_procs - 1] + lengths[num_procs - 1] : 0, ' ');
+    MPI_Gatherv(mine.data(), length, MPI_CHAR, &all[0], lengths.data(), offsets.data(), MPI_CHAR, 0,
+                MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        vector<Placement> layout;
+        istringstream text(all);
+        string line;
+        Placement p;
+        while (getline(text, line))
+            if (parse_layout_line(line, p))
+                layout.push_back(p);
+
+        cout << "\n";
+        print_layout(cout, layout);
+        for (string const& problem : check_layout(layout))
+            cout << "Warning: " << problem << "\n";
+
+        if (argc > 1)
+        {
+            ofstream csv(argv[1]);
+            write_layout(csv, layout);
+            cout << "Layout written to " << argv[1] << ".\n";
+        }
+    }
+
     MPI_Finalize();
-    
+
     return 0;
 }
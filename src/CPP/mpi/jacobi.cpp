@@ -10,18 +10,39 @@
     Since the local indices into the arrays will always be
     the same, the [start_index, end_index] will actually refer
     to the global index space so that x[i] can be computed.
+
+    In async mode the ranks do not wait for each other between iterations:
+    each rank keeps a receive posted for each neighbour, uses the latest halo
+    value that has arrived and only sends a new boundary value when the
+    previous send has gone out.  Termination is detected with a non-blocking
+    allreduce of the local convergence flags that overlaps the iterations,
+    followed by one synchronous iteration to confirm it.
+
+    The time spent in initialization, the stencil, the copy into u_old, halo
+    exchange, the convergence allreduce and output is timed on every rank (timers.h) and
+    reported as min / avg / max over the ranks at the end.
+
+    Usage: jacobi [sync|async] [num_points]
 */
 
 // MPI Library
 #include "mpi.h"
 
+// Vectorized exp on arrays
+#include "vmath.h"
+// Per-phase timers
+#include "timers.h"
+
 // Standard IO libraries
 #include <iostream>
 #include <fstream>
+#include <string>
 using namespace std;
 
 #include <math.h>
 
+enum Phase { INIT, COMPUTE, COPY, HALO, ALLREDUCE, OUTPUT };
+
 int main(int argc, char* argv[])
 {
     // MPI Variables
@@ -36,6 +57,11 @@ int main(int argc, char* argv[])
     int const MAX_ITERATIONS = pow(2, 16), PRINT_INTERVAL = 10;
     int N, num_points;
     double x, dx, tolerance, du_max, du_max_proc;
+    double start_time, end_time;
+
+    // Asynchronous mode, check for global convergence this often
+    int const ASYNC_CHECK_INTERVAL = 10;
+    bool use_async = (argc > 1 && string(argv[1]) == "async");
 
     // IO
     bool serial_output = true;
@@ -45,8 +71,13 @@ int main(int argc, char* argv[])
     MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+    PhaseTimers timers({"init", "compute", "copy", "halo", "allreduce", "output"});
+    timers.start(INIT);
+
     // Discretization
     num_points = 19;
+    if (argc > 2)
+        num_points = stoi(argv[2]);
     dx = (b - a) / ((double)(num_points + 1));
     tolerance = 0.1 * pow(dx, 2);
 
@@ -69,61 +100,242 @@ int main(int argc, char* argv[])
     for (int i = 0; i < rank_num_points + 2; ++i)
     {
         x = dx * (double) (i + start_index - 1) + a;
-        f[i] = exp(x);                     // RHS function
+        f[i] = x;                          // RHS function exp(x) below
         u[i] = alpha + x * (beta - alpha); // Initial guess
     }
+    vec_exp(f, f, rank_num_points + 2);
+    timers.stop(INIT);
 
-    /* Jacobi Iterations */
-    N = 0;
-    while (N < MAX_ITERATIONS)
+    // One synchronous iteration, returns du_max over all ranks
+    auto jacobi_iteration = [&]() -> double
     {
         // Copy u into u_old
-        for (int i = 0; i < rank_num_points + 2; ++i)
-            u_old[i] = u[i];
+        {
+            ScopedTimer timer(timers, COPY);
+            for (int i = 0; i < rank_num_points + 2; ++i)
+                u_old[i] = u[i];
+        }
 
+        {
+            ScopedTimer timer(timers, HALO);
 
-        // Send data to the right (tag = 1)
-        if (rank < num_procs - 1)
-            MPI_Isend(&u_old[rank_num_points], 1, MPI_DOUBLE_PRECISION, rank + 1, 1, MPI_COMM_WORLD, &request);
-        // Send data to the left (tag = 2)
-        if (rank > 0)
-            MPI_Isend(&u_old[1], 1, MPI_DOUBLE_PRECISION, rank - 1, 2, MPI_COMM_WORLD, &request);
+            // Send data to the right (tag = 1)
+            if (rank < num_procs - 1)
+                MPI_Isend(&u_old[rank_num_points], 1, MPI_DOUBLE_PRECISION, rank + 1, 1, MPI_COMM_WORLD, &request);
+            // Send data to the left (tag = 2)
+            if (rank > 0)
+                MPI_Isend(&u_old[1], 1, MPI_DOUBLE_PRECISION, rank - 1, 2, MPI_COMM_WORLD, &request);
 
-        // Receive data from the right (tag = 1)
-        if (rank < num_procs - 1)
-            MPI_Recv(&u_old[rank_num_points + 1], 1, MPI_DOUBLE_PRECISION, rank + 1, 2, MPI_COMM_WORLD, &status);
-        // Receive data from the left (tag = 2)
-        if (rank > 0)
-            MPI_Recv(&u_old[0], 1, MPI_DOUBLE_PRECISION, rank - 1, 1, MPI_COMM_WORLD, &status);
+            // Receive data from the right (tag = 1)
+            if (rank < num_procs - 1)
+                MPI_Recv(&u_old[rank_num_points + 1], 1, MPI_DOUBLE_PRECISION, rank + 1, 2, MPI_COMM_WORLD, &status);
+            // Receive data from the left (tag = 2)
+            if (rank > 0)
+                MPI_Recv(&u_old[0], 1, MPI_DOUBLE_PRECISION, rank - 1, 1, MPI_COMM_WORLD, &status);
+        }
 
         /* Apply Jacobi */
-        du_max_proc = 0.0;
-        for (int i = 1; i < rank_num_points + 1; ++i)
+        double du_max_proc = 0.0;
         {
-            u[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
-            du_max_proc = fmax(du_max_proc, fabs(u[i] - u_old[i]));
+            ScopedTimer timer(timers, COMPUTE);
+            for (int i = 1; i < rank_num_points + 1; ++i)
+            {
+                u[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
+                du_max_proc = fmax(du_max_proc, fabs(u[i] - u_old[i]));
+            }
         }
         /* ------------ */
 
         // Find global maximum change in solution - acts as an implicit barrier
+        double du_max;
+        ScopedTimer timer(timers, ALLREDUCE);
         MPI_Allreduce(&du_max_proc, &du_max, 1, MPI_DOUBLE_PRECISION, MPI_MAX, MPI_COMM_WORLD);
+        return du_max;
+    };
 
-        // Periodically report progress
-        if (rank == 0)
-            if (N%PRINT_INTERVAL == 0)
-                printf("After %d iterations, du_max = %f\n", N, du_max);
+    /* Jacobi Iterations */
+    start_time = MPI_Wtime();
+    N = 0;
+    if (!use_async)
+    {
+        while (N < MAX_ITERATIONS)
+        {
+            du_max = jacobi_iteration();
+
+            // Periodically report progress
+            if (rank == 0)
+                if (N%PRINT_INTERVAL == 0)
+                    printf("After %d iterations, du_max = %f\n", N, du_max);
+
+            // All processes have the same du_max and should check for convergence
+            if (du_max < tolerance)
+                break;
+            N++;
+        }
+    }
+    else
+    {
+        // Neighbours in the order left, right, MPI_PROC_NULL at the ends.
+        // Halo values travel with tags 5 (to the right) and 6 (to the left)
+        // so they never match the synchronous messages.
+        int const neighbor[2] = {rank > 0 ? rank - 1 : MPI_PROC_NULL,
+                                 rank < num_procs - 1 ? rank + 1 : MPI_PROC_NULL};
+        int const send_tag[2] = {6, 5}, recv_tag[2] = {5, 6};
+        int const halo[2] = {0, rank_num_points + 1};
+        int const edge[2] = {1, rank_num_points};
+        double send_buffer[2], recv_buffer[2];
+        MPI_Request send_request[2], recv_request[2];
+        long int sent[2], received[2];
+
+        int local_converged, all_converged, num_verifications = 0;
+        MPI_Request check_request;
+
+        while (true)
+        {
+            // Start (or resume) the asynchronous iterations
+            for (int side = 0; side < 2; ++side)
+            {
+                sent[side] = received[side] = 0;
+                send_request[side] = recv_request[side] = MPI_REQUEST_NULL;
+                if (neighbor[side] != MPI_PROC_NULL)
+                    MPI_Irecv(&recv_buffer[side], 1, MPI_DOUBLE_PRECISION, neighbor[side], recv_tag[side], MPI_COMM_WORLD, &recv_request[side]);
+            }
+            check_request = MPI_REQUEST_NULL;
+            bool stop = false;
+
+            while (!stop)
+            {
+                int flag;
+
+                // Take the most recent halo values that have arrived
+                timers.start(HALO);
+                for (int side = 0; side < 2; ++side)
+                {
+                    if (neighbor[side] == MPI_PROC_NULL)
+                        continue;
+                    MPI_Test(&recv_request[side], &flag, &status);
+                    while (flag)
+                    {
+                        u[halo[side]] = recv_buffer[side];
+                        received[side]++;
+                        MPI_Irecv(&recv_buffer[side], 1, MPI_DOUBLE_PRECISION, neighbor[side], recv_tag[side], MPI_COMM_WORLD, &recv_request[side]);
+                        MPI_Test(&recv_request[side], &flag, &status);
+                    }
+                }
+                timers.stop(HALO);
+
+                // Apply Jacobi with whatever halo we have
+                timers.start(COPY);
+                for (int i = 0; i < rank_num_points + 2; ++i)
+                    u_old[i] = u[i];
+                timers.stop(COPY);
+
+                timers.start(COMPUTE);
+                du_max_proc = 0.0;
+                for (int i = 1; i < rank_num_points + 1; ++i)
+                {
+                    u[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
+                    du_max_proc = fmax(du_max_proc, fabs(u[i] - u_old[i]));
+                }
+                N++;
+                timers.stop(COMPUTE);
+
+                // Send our new edge values unless the last ones are still in
+                // flight
+                timers.start(HALO);
+                for (int side = 0; side < 2; ++side)
+                {
+                    if (neighbor[side] == MPI_PROC_NULL)
+                        continue;
+                    MPI_Test(&send_request[side], &flag, MPI_STATUS_IGNORE);
+                    if (flag)
+                    {
+                        send_buffer[side] = u[edge[side]];
+                        MPI_Isend(&send_buffer[side], 1, MPI_DOUBLE_PRECISION, neighbor[side], send_tag[side], MPI_COMM_WORLD, &send_request[side]);
+                        sent[side]++;
+                    }
+                }
+                timers.stop(HALO);
+
+                if (rank == 0 && N%PRINT_INTERVAL == 0)
+                    printf("After %d iterations, local du_max = %f\n", N, du_max_proc);
+
+                // Every so often start a vote on whether everyone looks
+                // converged, and keep iterating while it is in progress
+                ScopedTimer timer(timers, ALLREDUCE);
+                if (check_request == MPI_REQUEST_NULL)
+                {
+                    if (N%ASYNC_CHECK_INTERVAL == 0 || N >= MAX_ITERATIONS)
+                    {
+                        local_converged = (du_max_proc < tolerance || N >= MAX_ITERATIONS);
+                        MPI_Iallreduce(&local_converged, &all_converged, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD, &check_request);
+                    }
+                }
+                else
+                {
+                    MPI_Test(&check_request, &flag, MPI_STATUS_IGNORE);
+                    if (flag && all_converged)
+                        stop = true;
+                }
+            }
 
-        // All processes have the same du_max and should check for convergence
-        if (du_max < tolerance)
-            break;
-        N++;
+            // Everyone agreed to stop.  Tell each neighbour how many halo
+            // messages we sent it and receive until we have all of them, then
+            // no asynchronous message is left in flight.
+            timers.start(HALO);
+            for (int side = 0; side < 2; ++side)
+            {
+                long int expected;
+                MPI_Sendrecv(&sent[side], 1, MPI_LONG, neighbor[side], 7,
+                             &expected, 1, MPI_LONG, neighbor[side], 7, MPI_COMM_WORLD, &status);
+                if (neighbor[side] == MPI_PROC_NULL)
+                    expected = 0;
+
+                while (received[side] < expected)
+                {
+                    MPI_Wait(&recv_request[side], &status);
+                    u[halo[side]] = recv_buffer[side];
+                    received[side]++;
+                    if (received[side] < expected)
+                        MPI_Irecv(&recv_buffer[side], 1, MPI_DOUBLE_PRECISION, neighbor[side], recv_tag[side], MPI_COMM_WORLD, &recv_request[side]);
+                    else
+                        recv_request[side] = MPI_REQUEST_NULL;
+                }
+                if (recv_request[side] != MPI_REQUEST_NULL)
+                {
+                    MPI_Cancel(&recv_request[side]);
+                    MPI_Wait(&recv_request[side], &status);
+                }
+                MPI_Wait(&send_request[side], MPI_STATUS_IGNORE);
+            }
+            timers.stop(HALO);
+
+            // The votes were cast at different times, confirm on a consistent
+            // state with one synchronous iteration and resume if it fails.
+            // The ranks made different numbers of sweeps, so they give up on
+            // the largest count to all stop together.
+            du_max = jacobi_iteration();
+            num_verifications++;
+            N++;
+            int max_N;
+            {
+                ScopedTimer timer(timers, ALLREDUCE);
+                MPI_Allreduce(&N, &max_N, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+            }
+            if (du_max < tolerance || max_N >= MAX_ITERATIONS)
+                break;
+        }
+
+        if (rank == 0)
+            cout << "Asynchronous Jacobi needed " << num_verifications << " synchronous verifications.\n";
     }
+    end_time = MPI_Wtime();
 
     cout << "Rank " << rank << " finished after " << N << " iterations, du_max = " << du_max << ".\n";
 
     // Output Results
-    // Check for failure
-    if (N >= MAX_ITERATIONS)
+    // Check for failure - du_max is the same on all ranks so they agree
+    if (!(du_max < tolerance))
     {
         if (rank == 0)
         {
@@ -135,8 +347,12 @@ int main(int argc, char* argv[])
         return 1;
     }
 
+    if (rank == 0)
+        cout << (use_async ? "Asynchronous" : "Synchronous") << " Jacobi took " << end_time - start_time << " s to reach the tolerance.\n";
+
     // Synchronize here before output
     MPI_Barrier(MPI_COMM_WORLD);
+    timers.start(OUTPUT);
 
     // Demonstration of two approaches to writing out files:
     if (serial_output)
@@ -208,6 +424,9 @@ int main(int argc, char* argv[])
 
         fp.close();
     }
+    timers.stop(OUTPUT);
+
+    timers.report(MPI_COMM_WORLD, cout);
 
     MPI_Finalize();
 
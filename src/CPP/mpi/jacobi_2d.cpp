@@ -9,18 +9,36 @@
         f(x, y) = -20 sin x cos 3 y
     using Jacobi iterations and MPI.  For simplicity we will assume that we 
     will use a uniform discretization.
+
+    Initialization, the stencil, the copy into u_old, packing and unpacking
+    the halo rows, waiting for them, the convergence allreduce and output
+    are timed on every rank
+    (timers.h) and reported as min / avg / max over the ranks at the end.
+    With a file name the phases of every iteration that is a multiple of
+    stride are also written there as a trace of all ranks (trace.h), to be
+    opened in chrome://tracing or ui.perfetto.dev.
+
+    Usage: jacobi_2d [trace.json] [stride]
 */
 
 // MPI Library
 #include "mpi.h"
 
+// Per-phase timers
+#include "timers.h"
+// Timelines of the phases on every rank
+#include "trace.h"
+
 // Standard IO libraries
 #include <iostream>
 #include <fstream>
+#include <string>
 using namespace std;
 
 #include <math.h>
 
+enum Phase { INIT, COMPUTE, COPY, PACK, HALO, UNPACK, ALLREDUCE, OUTPUT };
+
 int main(int argc, char *argv[])
 {
 
@@ -52,6 +70,17 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    vector<string> const phase_names = {"init", "compute", "copy", "pack", "halo wait", "unpack", "allreduce",
+                                              "output"};
+    PhaseTimers timers(phase_names);
+
+    // Tracing is off without a file
+    string trace_file = (argc > 1) ? argv[1] : "";
+    long int stride = (argc > 2) ? stol(argv[2]) : 1;
+    Tracer tracer(phase_names, 1, 1 << 16, trace_file.empty() ? 0 : stride);
+    timers.trace_to(tracer);
+    timers.start(INIT);
+
     // Discretization
     N = 100;
     dx = (pi - 0) / ((double)(N + 1));
@@ -125,14 +154,17 @@ int main(int argc, char *argv[])
     for (int i = 0; i < N + 2; ++i)
         for (int j = 0; j < rank_N + 2; ++j)
             u_old[i][j] = u[i][j];
+    timers.stop(INIT);
 
     /* Jacobi Iterations */
     k = 0;
     while (k < MAX_ITERATIONS)
     {
         k++;
+        tracer.set_iteration(0, k);
 
         du_max_proc = 0.0;
+        timers.start(COMPUTE);
         for (int i = 1; i < N + 1; ++i)
         {
             for (int j = 1; j < rank_N + 1; ++j)
@@ -141,9 +173,12 @@ int main(int argc, char *argv[])
                 du_max_proc = fmax(du_max_proc, fabs(u[i][j] - u_old[i][j]));
             }
         }
+        timers.stop(COMPUTE);
 
         // Final global max change in solution
+        timers.start(ALLREDUCE);
         MPI_Allreduce(&du_max_proc, &du_max, 1, MPI_DOUBLE_PRECISION, MPI_MAX, MPI_COMM_WORLD);
+        timers.stop(ALLREDUCE);
 
         if (rank == 0)
             if (N%PRINT_INTERVAL == 0)
@@ -153,30 +188,45 @@ int main(int argc, char *argv[])
             break;
 
         // Copy into old data that we have
-        for (int i = 1; i < N + 1; ++i)
-            for (int j = 1; j < rank_N + 1; ++j)
-                u_old[i][j] = u[i][j];
+        {
+            ScopedTimer timer(timers, COPY);
+            for (int i = 1; i < N + 1; ++i)
+                for (int j = 1; j < rank_N + 1; ++j)
+                    u_old[i][j] = u[i][j];
+        }
 
         // Communicate data
         // Send data up (tag = 1)
         if (rank < num_procs - 1)
         {
-            for (int i = 1; i < N + 1; ++i)
-                send_buffer[i - 1] = u_old[i][rank_N];
+            {
+                ScopedTimer timer(timers, PACK);
+                for (int i = 1; i < N + 1; ++i)
+                    send_buffer[i - 1] = u_old[i][rank_N];
+            }
+            ScopedTimer timer(timers, HALO);
             MPI_Isend(send_buffer, N, MPI_DOUBLE_PRECISION, rank + 1, 1, MPI_COMM_WORLD, &request);
         }
         // Send data down (tag = 2)
         if (rank > 0)
         {
-            for (int i = 1; i < N + 1; ++i)
-                send_buffer[i - 1] = u_old[i][1];
+            {
+                ScopedTimer timer(timers, PACK);
+                for (int i = 1; i < N + 1; ++i)
+                    send_buffer[i - 1] = u_old[i][1];
+            }
+            ScopedTimer timer(timers, HALO);
             MPI_Isend(send_buffer, N, MPI_DOUBLE_PRECISION, rank - 1, 2, MPI_COMM_WORLD, &request);
         }
 
         // Receive data from above (tag = 2)
         if (rank < num_procs - 1)
         {
-            MPI_Recv(recv_buffer, N, MPI_DOUBLE_PRECISION, rank + 1, 2, MPI_COMM_WORLD, &status);
+            {
+                ScopedTimer timer(timers, HALO);
+                MPI_Recv(recv_buffer, N, MPI_DOUBLE_PRECISION, rank + 1, 2, MPI_COMM_WORLD, &status);
+            }
+            ScopedTimer timer(timers, UNPACK);
             for (int i = 1; i < N + 1; ++i)
                 u_old[i][rank_N + 1] = recv_buffer[i - 1];
         }
@@ -184,7 +234,11 @@ int main(int argc, char *argv[])
         // Receive data from below (tag = 1)
         if (rank > 0)
         {
-            MPI_Recv(recv_buffer, N, MPI_DOUBLE_PRECISION, rank - 1, 1, MPI_COMM_WORLD, &status);
+            {
+                ScopedTimer timer(timers, HALO);
+                MPI_Recv(recv_buffer, N, MPI_DOUBLE_PRECISION, rank - 1, 1, MPI_COMM_WORLD, &status);
+            }
+            ScopedTimer timer(timers, UNPACK);
             for (int i = 1; i < N + 1; ++i)
                 u_old[i][0] = recv_buffer[i - 1];
         }
@@ -208,6 +262,8 @@ int main(int argc, char *argv[])
     // Write each row from bottom to top
     // Each rank writes out to it's own file and post-processing will handle opening
     // up all the files - rank determines the file names
+    tracer.set_iteration(0, -1);
+    timers.start(OUTPUT);
     string file_name = "jacobi_" + to_string(rank) + ".txt";
     ofstream fp(file_name);
 
@@ -234,6 +290,16 @@ int main(int argc, char *argv[])
     }
 
     fp.close();
+    timers.stop(OUTPUT);
+
+    timers.report(MPI_COMM_WORLD, cout);
+
+    if (tracer.enabled())
+    {
+        write_trace(tracer, MPI_COMM_WORLD, trace_file);
+        if (rank == 0)
+            cout << "Trace written to " << trace_file << ".\n";
+    }
 
     MPI_Finalize();
 
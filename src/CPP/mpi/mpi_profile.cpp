@@ -0,0 +1,330 @@
+/*
+    Communication profile of any MPI program through the PMPI interface.
+
+    Usage: mpirun -np 4 -x LD_PRELOAD=$PWD/libmpiprofile.so ./jacobi_2d
+           (or link libmpiprofile.so before the MPI library)
+
+    Every MPI function has a second name, PMPI_..., so a library that defines
+    MPI_Send itself and calls PMPI_Send for the real work sees every call
+    without changes to the program.  This one wraps
+        MPI_Send, MPI_Isend, MPI_Ssend, MPI_Recv, MPI_Irecv, MPI_Sendrecv,
+        MPI_Wait, MPI_Waitall, MPI_Barrier, MPI_Bcast, MPI_Reduce and
+        MPI_Allreduce
+    and counts per rank the calls, bytes and seconds of each, and the bytes
+    and messages sent to every other rank (in MPI_COMM_WORLD numbering).
+    Receive bytes are those that arrived for MPI_Recv and MPI_Sendrecv and
+    the posted size for MPI_Irecv.  The time of a non-blocking call is only
+    the time to start it, the waiting shows up in MPI_Wait and MPI_Waitall.
+
+    At MPI_Finalize rank 0 gathers everything and writes mpi_profile.txt (or
+    the file named by MPI_PROFILE_FILE) with
+        - per function: calls, bytes and the min / avg / max seconds over
+          the ranks,
+        - per rank: the seconds in MPI against the time since MPI_Init, and
+        - the matrices of bytes and messages sent from rank (row) to rank.
+    The wrappers keep plain counters, a few tens of nanoseconds per call, and
+    assume that only one thread calls MPI at a time.
+*/
+
+// MPI Library
+#include "mpi.h"
+
+// Standard IO libraries
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+    enum Call { SEND, ISEND, SSEND, RECV, IRECV, SENDRECV, WAIT, WAITALL, BARRIER, BCAST, REDUCE, ALLREDUCE,
+                NUM_CALLS };
+    char const* const CALL_NAMES[] = {"MPI_Send", "MPI_Isend", "MPI_Ssend", "MPI_Recv", "MPI_Irecv",
+                                      "MPI_Sendrecv", "MPI_Wait", "MPI_Waitall", "MPI_Barrier", "MPI_Bcast",
+                                      "MPI_Reduce", "MPI_Allreduce"};
+
+    struct Profile
+    {
+        int rank = 0, num_procs = 1;
+        double start_time = 0.0;
+        double calls[NUM_CALLS] = {}, bytes[NUM_CALLS] = {}, seconds[NUM_CALLS] = {};
+        vector<double> sent_bytes, sent_messages;
+    };
+    Profile profile;
+
+    void start_profile()
+    {
+        PMPI_Comm_rank(MPI_COMM_WORLD, &profile.rank);
+        PMPI_Comm_size(MPI_COMM_WORLD, &profile.num_procs);
+        profile.sent_bytes.assign(profile.num_procs, 0.0);
+        profile.sent_messages.assign(profile.num_procs, 0.0);
+        profile.start_time = PMPI_Wtime();
+    }
+
+    double message_bytes(int count, MPI_Datatype datatype)
+    {
+        int size;
+        PMPI_Type_size(datatype, &size);
+        return (double)count * size;
+    }
+
+    // Rank of a peer in MPI_COMM_WORLD, -1 for MPI_PROC_NULL and the like
+    int world_rank(int peer, MPI_Comm comm)
+    {
+        if (peer < 0)
+            return -1;
+        if (comm == MPI_COMM_WORLD)
+            return peer;
+        MPI_Group group, world_group;
+        int world;
+        PMPI_Comm_group(comm, &group);
+        PMPI_Comm_group(MPI_COMM_WORLD, &world_group);
+        PMPI_Group_translate_ranks(group, 1, &peer, world_group, &world);
+        PMPI_Group_free(&group);
+        PMPI_Group_free(&world_group);
+        return (world == MPI_UNDEFINED) ? -1 : world;
+    }
+
+    void record(Call call, double bytes, double start)
+    {
+        profile.calls[call] += 1.0;
+        profile.bytes[call] += bytes;
+        profile.seconds[call] += PMPI_Wtime() - start;
+    }
+
+    void record_send(int dest, MPI_Comm comm, double bytes)
+    {
+        int peer = world_rank(dest, comm);
+        if (peer >= 0 && peer < (int)profile.sent_bytes.size())
+        {
+            profile.sent_bytes[peer] += bytes;
+            profile.sent_messages[peer] += 1.0;
+        }
+    }
+
+    // Calls, bytes and seconds of every function, then the sent bytes and
+    // messages to every rank
+    void write_profile()
+    {
+        int P = profile.num_procs, row = 3 * NUM_CALLS + 2 * P + 1;
+        vector<double> mine;
+        mine.insert(mine.end(), profile.calls, profile.calls + NUM_CALLS);
+        mine.insert(mine.end(), profile.bytes, profile.bytes + NUM_CALLS);
+        mine.insert(mine.end(), profile.seconds, profile.seconds + NUM_CALLS);
+        mine.insert(mine.end(), profile.sent_bytes.begin(), profile.sent_bytes.end());
+        mine.insert(mine.end(), profile.sent_messages.begin(), profile.sent_messages.end());
+        mine.push_back(PMPI_Wtime() - profile.start_time);
+
+        vector<double> all(profile.rank == 0 ? (size_t)row * P : 0);
+        PMPI_Gather(mine.data(), row, MPI_DOUBLE, all.data(), row, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        if (profile.rank != 0)
+            return;
+
+        auto at = [&](int rank, int index) { return all[(size_t)rank * row + index]; };
+        char const* name = getenv("MPI_PROFILE_FILE");
+        string file_name = (name != NULL) ? name : "mpi_profile.txt";
+        ofstream out(file_name);
+        char line[256];
+
+        out << "MPI profile of " << P << " ranks\n\n";
+        snprintf(line, sizeof(line), "%-14s %12s %14s %11s %11s %11s\n", "function", "calls", "bytes", "min s",
+                 "avg s", "max s");
+        out << line;
+        for (int c = 0; c < NUM_CALLS; ++c)
+        {
+            double calls = 0.0, bytes = 0.0, sum = 0.0, minimum = 1e300, maximum = 0.0;
+            for (int r = 0; r < P; ++r)
+            {
+                double s = at(r, 2 * NUM_CALLS + c);
+                calls += at(r, c);
+                bytes += at(r, NUM_CALLS + c);
+                sum += s;
+                minimum = min(minimum, s);
+                maximum = max(maximum, s);
+            }
+            if (calls == 0.0)
+                continue;
+            snprintf(line, sizeof(line), "%-14s %12.0f %14.0f %11.4e %11.4e %11.4e\n", CALL_NAMES[c], calls, bytes,
+                     minimum, sum / P, maximum);
+            out << line;
+        }
+
+        out << "\n";
+        snprintf(line, sizeof(line), "%-6s %11s %11s %7s\n", "rank", "MPI s", "run s", "% MPI");
+        out << line;
+        for (int r = 0; r < P; ++r)
+        {
+            double in_mpi = 0.0, run = at(r, row - 1);
+            for (int c = 0; c < NUM_CALLS; ++c)
+                in_mpi += at(r, 2 * NUM_CALLS + c);
+            snprintf(line, sizeof(line), "%-6d %11.4e %11.4e %7.2f\n", r, in_mpi, run,
+                     run > 0.0 ? 100.0 * in_mpi / run : 0.0);
+            out << line;
+        }
+
+        char const* titles[] = {"Bytes sent, from rank (row) to rank (column)", "Messages sent"};
+        for (int m = 0; m < 2; ++m)
+        {
+            out << "\n" << titles[m] << "\n" << setw(6) << "";
+            for (int to = 0; to < P; ++to)
+                out << setw(13) << to;
+            out << "\n";
+            for (int from = 0; from < P; ++from)
+            {
+                out << setw(6) << from;
+                for (int to = 0; to < P; ++to)
+                    out << setw(13) << (long long)at(from, 3 * NUM_CALLS + m * P + to);
+                out << "\n";
+            }
+        }
+        fprintf(stderr, "mpi_profile: wrote %s\n", file_name.c_str());
+    }
+}
+
+extern "C"
+{
+
+int MPI_Init(int* argc, char*** argv)
+{
+    int result = PMPI_Init(argc, argv);
+    start_profile();
+    return result;
+}
+
+int MPI_Init_thread(int* argc, char*** argv, int required, int* provided)
+{
+    int result = PMPI_Init_thread(argc, argv, required, provided);
+    start_profile();
+    return result;
+}
+
+int MPI_Finalize(void)
+{
+    write_profile();
+    return PMPI_Finalize();
+}
+
+int MPI_Send(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
+{
+    double start = PMPI_Wtime(), bytes = message_bytes(count, datatype);
+    int result = PMPI_Send(buf, count, datatype, dest, tag, comm);
+    record(SEND, bytes, start);
+    record_send(dest, comm, bytes);
+    return result;
+}
+
+int MPI_Isend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm,
+              MPI_Request* request)
+{
+    double start = PMPI_Wtime(), bytes = message_bytes(count, datatype);
+    int result = PMPI_Isend(buf, count, datatype, dest, tag, comm, request);
+    record(ISEND, bytes, start);
+    record_send(dest, comm, bytes);
+    return result;
+}
+
+int MPI_Ssend(const void* buf, int count, MPI_Datatype datatype, int dest, int tag, MPI_Comm comm)
+{
+    double start = PMPI_Wtime(), bytes = message_bytes(count, datatype);
+    int result = PMPI_Ssend(buf, count, datatype, dest, tag, comm);
+    record(SSEND, bytes, start);
+    record_send(dest, comm, bytes);
+    return result;
+}
+
+int MPI_Recv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm, MPI_Status* status)
+{
+    MPI_Status own_status;
+    if (status == MPI_STATUS_IGNORE)
+        status = &own_status;
+    double start = PMPI_Wtime();
+    int result = PMPI_Recv(buf, count, datatype, source, tag, comm, status);
+    int received = 0;
+    if (source != MPI_PROC_NULL)
+        PMPI_Get_count(status, datatype, &received);
+    record(RECV, message_bytes(received == MPI_UNDEFINED ? 0 : received, datatype), start);
+    return result;
+}
+
+int MPI_Irecv(void* buf, int count, MPI_Datatype datatype, int source, int tag, MPI_Comm comm,
+              MPI_Request* request)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Irecv(buf, count, datatype, source, tag, comm, request);
+    record(IRECV, message_bytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Sendrecv(const void* sendbuf, int sendcount, MPI_Datatype sendtype, int dest, int sendtag, void* recvbuf,
+                 int recvcount, MPI_Datatype recvtype, int source, int recvtag, MPI_Comm comm, MPI_Status* status)
+{
+    MPI_Status own_status;
+    if (status == MPI_STATUS_IGNORE)
+        status = &own_status;
+    double start = PMPI_Wtime(), sent = message_bytes(sendcount, sendtype);
+    int result = PMPI_Sendrecv(sendbuf, sendcount, sendtype, dest, sendtag, recvbuf, recvcount, recvtype, source,
+                               recvtag, comm, status);
+    int received = 0;
+    if (source != MPI_PROC_NULL)
+        PMPI_Get_count(status, recvtype, &received);
+    record(SENDRECV, sent + message_bytes(received == MPI_UNDEFINED ? 0 : received, recvtype), start);
+    if (dest != MPI_PROC_NULL)
+        record_send(dest, comm, sent);
+    return result;
+}
+
+int MPI_Wait(MPI_Request* request, MPI_Status* status)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Wait(request, status);
+    record(WAIT, 0.0, start);
+    return result;
+}
+
+int MPI_Waitall(int count, MPI_Request array_of_requests[], MPI_Status* array_of_statuses)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Waitall(count, array_of_requests, array_of_statuses);
+    record(WAITALL, 0.0, start);
+    return result;
+}
+
+int MPI_Barrier(MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Barrier(comm);
+    record(BARRIER, 0.0, start);
+    return result;
+}
+
+int MPI_Bcast(void* buffer, int count, MPI_Datatype datatype, int root, MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Bcast(buffer, count, datatype, root, comm);
+    record(BCAST, message_bytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Reduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, int root,
+               MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Reduce(sendbuf, recvbuf, count, datatype, op, root, comm);
+    record(REDUCE, message_bytes(count, datatype), start);
+    return result;
+}
+
+int MPI_Allreduce(const void* sendbuf, void* recvbuf, int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int result = PMPI_Allreduce(sendbuf, recvbuf, count, datatype, op, comm);
+    record(ALLREDUCE, message_bytes(count, datatype), start);
+    return result;
+}
+
+}
@@ -1,33 +1,53 @@
+/*
+    Pass a message down the chain of ranks, and broadcasts built on that.
+
+    Usage: note_passing [chain|pipeline|tree|bcast|compare] [bytes] [segment_bytes]
+
+    Without arguments a single double goes from rank to rank, each printing
+    what it received.  Otherwise rank 0 broadcasts bytes (default 16 MiB) with
+        chain       the whole message rank to rank, (P - 1) message times
+        pipeline    the chain, but in segments: rank r forwards a segment as
+                    soon as it has arrived, so the segments move down the
+                    chain one behind the other and the broadcast takes about
+                    one message time + (P - 2) segment times
+        tree        the same pipeline down a binary tree (children 2 r + 1
+                    and 2 r + 2), about log2(P) hops but every rank sends
+                    twice
+        bcast       MPI_Bcast
+        compare     all of them, with speedups over MPI_Bcast
+    Small segments fill the pipeline sooner but pay the latency more often.
+    segment_bytes of 0 (the default) tunes it: every power of two from 1 KiB
+    up to the message is timed and the fastest kept.
+
+    Times are the median over repetitions of the time until the last rank
+    has the message, and every rank checks what it received.
+*/
+
 // MPI Library
 #include "mpi.h"
 
 // Standard IO libraries
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include <vector>
 using namespace std;
 
-int main(int argc, char* argv[])
+enum Broadcast { CHAIN, PIPELINE, TREE, BCAST };
+string const BROADCAST_NAMES[] = {"chain", "pipeline", "tree", "bcast"};
+
+int const TAG = 42;
+int const REPETITIONS = 10;
+long int const MIN_SEGMENT = 1024;
+
+// The original demo, one double passed down the chain
+void pass_note(int rank, int num_procs)
 {
-    int num_procs, rank;
     MPI_Status status;
 
     int tag;
     double message;
 
-    // Initialize MPI
-    MPI_Init(&argc, &argv);
-
-    // Get total number of processes and this processes' rank
-    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
-    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-    // If we only have one process then we are alone and cannot message anyone :(
-    if (num_procs == 1)
-    {
-        cout << "Only one process used, no messages passed.\n";
-        MPI_Finalize();
-        return 0;
-    }
-
     // Not super important for us
     tag = 42;
 
@@ -48,7 +68,7 @@ int main(int argc, char* argv[])
         cout << "Process " << rank << " recieved message = " << message << "\n";
         cout << "Process " << rank << " sending message = " << message << "\n";
         MPI_Send(&message, 1, MPI_DOUBLE_PRECISION, rank+1, tag, MPI_COMM_WORLD);
-        
+
     }
     else if (rank == num_procs - 1)
     {
@@ -57,8 +77,197 @@ int main(int argc, char* argv[])
 
         cout << "Process " << rank << " recieved message = " << message << "\n";
     }
+}
+
+// Segments received from parent are forwarded to the children as each one
+// arrives, rank 0 is the root.  A segment as large as the message is the
+// plain store and forward.
+void pipelined_broadcast(vector<char>& message, long int segment, int parent, vector<int> const& children)
+{
+    long int bytes = message.size();
+    int num_segments = (int)((bytes + segment - 1) / segment);
+    vector<MPI_Request> receives(num_segments, MPI_REQUEST_NULL), sends;
+    sends.reserve((size_t)num_segments * children.size());
+
+    if (parent >= 0)
+        for (int s = 0; s < num_segments; ++s)
+        {
+            long int offset = s * segment;
+            MPI_Irecv(&message[offset], (int)min(segment, bytes - offset), MPI_BYTE, parent, TAG, MPI_COMM_WORLD,
+                      &receives[s]);
+        }
+
+    for (int s = 0; s < num_segments; ++s)
+    {
+        long int offset = s * segment;
+        if (parent >= 0)
+            MPI_Wait(&receives[s], MPI_STATUS_IGNORE);
+        for (int child : children)
+        {
+            sends.push_back(MPI_REQUEST_NULL);
+            MPI_Isend(&message[offset], (int)min(segment, bytes - offset), MPI_BYTE, child, TAG, MPI_COMM_WORLD,
+                      &sends.back());
+        }
+    }
+    MPI_Waitall((int)sends.size(), sends.data(), MPI_STATUSES_IGNORE);
+}
+
+// Median seconds of a broadcast, and whether every rank got the message
+double time_broadcast(Broadcast method, long int bytes, long int segment, int rank, int num_procs, bool& correct)
+{
+    int parent = -1;
+    vector<int> children;
+    if (method == TREE)
+    {
+        parent = (rank > 0) ? (rank - 1) / 2 : -1;
+        for (int child = 2 * rank + 1; child <= 2 * rank + 2 && child < num_procs; ++child)
+            children.push_back(child);
+    }
+    else
+    {
+        parent = rank - 1;
+        if (rank + 1 < num_procs)
+            children.push_back(rank + 1);
+        if (method == CHAIN)
+            segment = bytes;
+    }
+
+    vector<char> message(bytes);
+    vector<double> times;
+    int errors = 0;
+    for (int repetition = 0; repetition < REPETITIONS + 1; ++repetition)
+    {
+        for (long int i = 0; i < bytes; ++i)
+            message[i] = (rank == 0) ? (char)(i * 7 + repetition) : 0;
+
+        MPI_Barrier(MPI_COMM_WORLD);
+        double start = MPI_Wtime();
+        if (method == BCAST)
+            MPI_Bcast(message.data(), (int)bytes, MPI_BYTE, 0, MPI_COMM_WORLD);
+        else
+            pipelined_broadcast(message, segment, parent, children);
+        double elapsed = MPI_Wtime() - start, slowest;
+        MPI_Allreduce(&elapsed, &slowest, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+
+        for (long int i = 0; i < bytes; ++i)
+            errors += (message[i] != (char)(i * 7 + repetition));
+        // The first one is warm up
+        if (repetition > 0)
+            times.push_back(slowest);
+    }
+
+    int total_errors;
+    MPI_Allreduce(&errors, &total_errors, 1, MPI_INT, MPI_SUM, MPI_COMM_WORLD);
+    correct = (total_errors == 0);
+
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// The fastest power of two segment, every rank gets the same answer since
+// the times are reduced over all of them
+long int tune_segment(Broadcast method, long int bytes, int rank, int num_procs)
+{
+    long int best_segment = bytes;
+    double best_time = 1e30;
+    for (long int segment = MIN_SEGMENT; ; segment *= 2)
+    {
+        segment = min(segment, bytes);
+        bool correct;
+        double time = time_broadcast(method, bytes, segment, rank, num_procs, correct);
+        if (time < best_time)
+        {
+            best_time = time;
+            best_segment = segment;
+        }
+        if (segment == bytes)
+            break;
+    }
+    return best_segment;
+}
+
+int main(int argc, char* argv[])
+{
+    int num_procs, rank;
+
+    // Initialize MPI
+    MPI_Init(&argc, &argv);
+
+    // Get total number of processes and this processes' rank
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // If we only have one process then we are alone and cannot message anyone :(
+    if (num_procs == 1)
+    {
+        cout << "Only one process used, no messages passed.\n";
+        MPI_Finalize();
+        return 0;
+    }
+
+    if (argc < 2)
+    {
+        pass_note(rank, num_procs);
+        MPI_Finalize();
+        return 0;
+    }
+
+    string mode = argv[1];
+    long int bytes = (argc > 2) ? max(1L, stol(argv[2])) : 16L << 20;
+    long int segment = (argc > 3) ? stol(argv[3]) : 0;
+
+    vector<Broadcast> methods;
+    for (int m = CHAIN; m <= BCAST; ++m)
+        if (mode == "compare" || mode == BROADCAST_NAMES[m])
+            methods.push_back((Broadcast)m);
+    if (methods.empty())
+    {
+        if (rank == 0)
+            cout << "Usage: note_passing [chain|pipeline|tree|bcast|compare] [bytes] [segment_bytes]\n";
+        MPI_Finalize();
+        return 1;
+    }
+
+    if (rank == 0)
+        cout << "Broadcast of " << bytes << " bytes from rank 0 to " << num_procs << " ranks.\n";
+
+    double bcast_time = 0.0, chain_time = 0.0;
+    vector<double> times;
+    for (Broadcast method : methods)
+    {
+        long int used_segment = bytes;
+        if (method == PIPELINE || method == TREE)
+            used_segment = (segment > 0) ? min(segment, bytes) : tune_segment(method, bytes, rank, num_procs);
+
+        bool correct;
+        double time = time_broadcast(method, bytes, used_segment, rank, num_procs, correct);
+        times.push_back(time);
+        if (method == BCAST)
+            bcast_time = time;
+        if (method == CHAIN)
+            chain_time = time;
+
+        if (rank == 0)
+        {
+            cout << BROADCAST_NAMES[method] << ": " << time * 1e3 << " ms, " << bytes / time / 1e9 << " GB/s";
+            if (method == PIPELINE || method == TREE)
+                cout << ", " << (segment > 0 ? "" : "tuned ") << "segment " << used_segment << " bytes";
+            cout << (correct ? "" : ", *** WRONG MESSAGE ***") << ".\n";
+        }
+    }
+
+    if (rank == 0 && mode == "compare")
+    {
+        // The chain makes P - 1 hops of the whole message
+        double message_time = chain_time / (num_procs - 1);
+        cout << "One message time " << message_time * 1e3 << " ms, (P - 1) of them " << chain_time * 1e3 << " ms.\n";
+        for (size_t m = 0; m < methods.size(); ++m)
+            if (methods[m] != BCAST)
+                cout << "Speedup of " << BROADCAST_NAMES[methods[m]] << " over MPI_Bcast " << bcast_time / times[m]
+                     << ".\n";
+    }
 
     MPI_Finalize();
-    
+
     return 0;
 }
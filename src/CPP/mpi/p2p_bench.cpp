@@ -0,0 +1,378 @@
+/*
+    Point-to-point latency, bandwidth and message rate, grown out of
+    note_passing.cpp.
+
+    Usage: p2p_bench [-t test] [-m method] [-s min_bytes] [-S max_bytes] [-i iterations] [-w warmup]
+                     [-o file.csv]
+
+        -t   pingpong, bandwidth, bibandwidth, rate or all (default all)
+        -m   send, isend, ssend, persistent, rma or all (default all)
+        -s   smallest message, doubled up to -S (default 1 B to 64 MiB)
+        -i   timed iterations for messages up to 64 KiB, fewer for larger
+             ones so that every size moves about as many bytes (default 1000)
+        -w   untimed iterations before them (default 100, scaled alike)
+        -o   also write every row to a CSV file
+
+    Tests, between rank 0 and rank P / 2 (so that with ranks placed node by
+    node they are on different nodes) while the others wait, except for rate:
+        pingpong      one message there and one back, the sample is half of
+                      the round trip
+        bandwidth     a window of messages one way, answered by an empty
+                      message once all have arrived
+        bibandwidth   windows both ways at the same time, receives posted
+                      first
+        rate          bandwidth on all pairs (r, r + P / 2) at once, reported
+                      as messages per second over all pairs
+    Methods:
+        send          MPI_Send and MPI_Recv
+        isend         MPI_Isend and MPI_Irecv, one MPI_Waitall per window
+        ssend         MPI_Ssend, which completes only once the receive has
+                      started, against MPI_Recv
+        persistent    MPI_Send_init and MPI_Recv_init once per size, then
+                      MPI_Startall and MPI_Waitall
+        rma           MPI_Put into the peer's window, synchronized by
+                      MPI_Win_fence
+    The window is 64 messages up to 64 KiB and 4 MiB worth above, each
+    message with a receive buffer of its own.
+
+    Every sample is timed on its own, and the table gives the minimum,
+    median, 90th and 99th percentile and maximum with the bandwidth and
+    message rate of the median.  Sample times are per message for pingpong
+    and per window for the others.
+*/
+
+// MPI Library
+#include "mpi.h"
+
+// Standard IO libraries
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <math.h>
+
+enum Test { PINGPONG, BANDWIDTH, BIBANDWIDTH, RATE };
+enum Method { SEND, ISEND, SSEND, PERSISTENT, RMA };
+
+string const TEST_NAMES[] = {"pingpong", "bandwidth", "bibandwidth", "rate"};
+string const METHOD_NAMES[] = {"send", "isend", "ssend", "persistent", "rma"};
+
+int const TAG = 42;
+
+// Messages per window, and the bytes per sweep step that set the number of
+// iterations of large messages
+int const WINDOW = 64;
+long int const WINDOW_BYTES = 4 << 20;
+long int const FULL_ITERATIONS_BYTES = 64 << 10;
+
+// One side of a pair of ranks, the communicator holds just the two
+struct Pair
+{
+    MPI_Comm comm;
+    int me, peer;
+    vector<char> send_buffer, receive_buffer;
+    MPI_Win win;
+    vector<MPI_Request> requests;
+};
+
+int window_size(Test test, long int bytes)
+{
+    if (test == PINGPONG)
+        return 1;
+    return (bytes <= FULL_ITERATIONS_BYTES) ? WINDOW : max(1L, WINDOW_BYTES / bytes);
+}
+
+// Starts window receives and then sends the same number of messages, or
+// either one alone, and waits for all of them
+void exchange(Pair& p, Method method, long int bytes, int window, bool send, bool receive)
+{
+    char* out = p.send_buffer.data();
+    char* in = p.receive_buffer.data();
+    MPI_Request* sends = p.requests.data();
+    MPI_Request* receives = sends + window;
+
+    if (method == RMA)
+    {
+        if (send)
+            for (int w = 0; w < window; ++w)
+                MPI_Put(out, bytes, MPI_BYTE, p.peer, (MPI_Aint)w * bytes, bytes, MPI_BYTE, p.win);
+        MPI_Win_fence(0, p.win);
+        return;
+    }
+    if (method == PERSISTENT)
+    {
+        if (receive)
+            MPI_Startall(window, receives);
+        if (send)
+            MPI_Startall(window, sends);
+    }
+    else
+    {
+        // Blocking sends too need the receives posted first when both sides
+        // send, or large messages would deadlock
+        bool nonblocking_receives = (method == ISEND) || (send && receive);
+        if (receive && nonblocking_receives)
+            for (int w = 0; w < window; ++w)
+                MPI_Irecv(in + w * bytes, bytes, MPI_BYTE, p.peer, TAG, p.comm, &receives[w]);
+        if (send)
+            for (int w = 0; w < window; ++w)
+            {
+                if (method == SEND)
+                    MPI_Send(out, bytes, MPI_BYTE, p.peer, TAG, p.comm);
+                else if (method == SSEND)
+                    MPI_Ssend(out, bytes, MPI_BYTE, p.peer, TAG, p.comm);
+                else
+                    MPI_Isend(out, bytes, MPI_BYTE, p.peer, TAG, p.comm, &sends[w]);
+            }
+        if (receive && !nonblocking_receives)
+            for (int w = 0; w < window; ++w)
+                MPI_Recv(in + w * bytes, bytes, MPI_BYTE, p.peer, TAG, p.comm, MPI_STATUS_IGNORE);
+        if (method != ISEND)
+        {
+            if (receive && nonblocking_receives)
+                MPI_Waitall(window, receives, MPI_STATUSES_IGNORE);
+            return;
+        }
+    }
+    if (send)
+        MPI_Waitall(window, sends, MPI_STATUSES_IGNORE);
+    if (receive)
+        MPI_Waitall(window, receives, MPI_STATUSES_IGNORE);
+}
+
+// One iteration of the test, in seconds
+double iteration(Pair& p, Test test, Method method, long int bytes, int window)
+{
+    double start = MPI_Wtime();
+    switch (test)
+    {
+        case PINGPONG:
+            // The fence of the first put is the second's start
+            exchange(p, method, bytes, 1, p.me == 0, p.me == 1);
+            exchange(p, method, bytes, 1, p.me == 1, p.me == 0);
+            return (MPI_Wtime() - start) / 2.0;
+        case BANDWIDTH:
+        case RATE:
+            exchange(p, method, bytes, window, p.me == 0, p.me == 1);
+            if (method != RMA)
+            {
+                if (p.me == 0)
+                    MPI_Recv(NULL, 0, MPI_BYTE, p.peer, TAG + 1, p.comm, MPI_STATUS_IGNORE);
+                else
+                    MPI_Send(NULL, 0, MPI_BYTE, p.peer, TAG + 1, p.comm);
+            }
+            return MPI_Wtime() - start;
+        case BIBANDWIDTH:
+            exchange(p, method, bytes, window, true, true);
+            return MPI_Wtime() - start;
+    }
+    return 0.0;
+}
+
+// Samples of one size, NaN on ranks outside of the pairs
+vector<double> measure(Pair* p, Test test, Method method, long int bytes, int iterations, int warmup)
+{
+    int window = window_size(test, bytes);
+    vector<double> samples(iterations, NAN);
+    if (p == NULL)
+        return samples;
+
+    p->requests.assign(2 * window, MPI_REQUEST_NULL);
+    if (method == PERSISTENT)
+        for (int w = 0; w < window; ++w)
+        {
+            MPI_Send_init(p->send_buffer.data(), bytes, MPI_BYTE, p->peer, TAG, p->comm, &p->requests[w]);
+            MPI_Recv_init(p->receive_buffer.data() + w * bytes, bytes, MPI_BYTE, p->peer, TAG, p->comm,
+                          &p->requests[window + w]);
+        }
+
+    for (int i = 0; i < warmup; ++i)
+        iteration(*p, test, method, bytes, window);
+    MPI_Barrier(p->comm);
+    for (int i = 0; i < iterations; ++i)
+        samples[i] = iteration(*p, test, method, bytes, window);
+
+    if (method == PERSISTENT)
+        for (auto& request : p->requests)
+            MPI_Request_free(&request);
+    return samples;
+}
+
+// Value at fraction q of the sorted samples, nearest rank
+double percentile(vector<double> const& sorted, double q)
+{
+    size_t index = (size_t)ceil(q * sorted.size());
+    return sorted[min(sorted.size() - 1, index > 0 ? index - 1 : 0)];
+}
+
+int main(int argc, char* argv[])
+{
+    int num_procs, rank;
+
+    // Initialize MPI
+    MPI_Init(&argc, &argv);
+
+    // Get total number of processes and this processes' rank
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    // Every rank reads the same command line
+    string test_name = "all", method_name = "all", csv_name;
+    long int min_bytes = 1, max_bytes = 64L << 20;
+    int max_iterations = 1000, max_warmup = 100;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "-t")
+            test_name = value;
+        else if (flag == "-m")
+            method_name = value;
+        else if (flag == "-s")
+            min_bytes = max(1L, stol(value));
+        else if (flag == "-S")
+            max_bytes = stol(value);
+        else if (flag == "-i")
+            max_iterations = max(1, stoi(value));
+        else if (flag == "-w")
+            max_warmup = max(0, stoi(value));
+        else if (flag == "-o")
+            csv_name = value;
+    }
+    vector<Test> tests;
+    vector<Method> methods;
+    for (int t = PINGPONG; t <= RATE; ++t)
+        if (test_name == "all" || test_name == TEST_NAMES[t])
+            tests.push_back((Test)t);
+    for (int m = SEND; m <= RMA; ++m)
+        if (method_name == "all" || method_name == METHOD_NAMES[m])
+            methods.push_back((Method)m);
+    if (tests.empty() || methods.empty() || max_bytes < min_bytes || num_procs < 2)
+    {
+        if (rank == 0)
+        {
+            if (num_procs < 2)
+                cout << "Only one process used, no messages passed.\n";
+            cout << "Usage: p2p_bench [-t test] [-m method] [-s min_bytes] [-S max_bytes] [-i iterations] [-w warmup]\n";
+            cout << "                 [-o file.csv]\n";
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Rank r is paired with r + P / 2, the first pair is the one of the
+    // single pair tests
+    int half = num_procs / 2, num_pairs = half;
+    bool paired = rank < 2 * half;
+    int pair_index = rank % half;
+    Pair pairs[2];
+    Pair* single = NULL;
+    Pair* all = NULL;
+    MPI_Comm comms[2];
+    MPI_Comm_split(MPI_COMM_WORLD, (paired && pair_index == 0) ? 0 : MPI_UNDEFINED, rank, &comms[0]);
+    MPI_Comm_split(MPI_COMM_WORLD, paired ? pair_index : MPI_UNDEFINED, rank, &comms[1]);
+
+    // Send buffers hold one message, receive buffers and windows a window
+    long int capacity = max(max_bytes, min(WINDOW_BYTES, WINDOW * max_bytes));
+    for (int c = 0; c < 2; ++c)
+    {
+        if (comms[c] == MPI_COMM_NULL)
+            continue;
+        Pair& p = pairs[c];
+        p.comm = comms[c];
+        MPI_Comm_rank(p.comm, &p.me);
+        p.peer = 1 - p.me;
+        p.send_buffer.assign(max_bytes, (char)p.me);
+        p.receive_buffer.assign(capacity, 0);
+        MPI_Win_create(p.receive_buffer.data(), capacity, 1, MPI_INFO_NULL, p.comm, &p.win);
+        MPI_Win_fence(0, p.win);
+        if (c == 0)
+            single = &p;
+        else
+            all = &p;
+    }
+
+    ofstream csv;
+    if (rank == 0)
+    {
+        cout << "Point-to-point tests between " << num_procs << " ranks, " << num_pairs << " pair(s) for rate.\n";
+        if (!csv_name.empty())
+        {
+            csv.open(csv_name);
+            csv << "test,method,bytes,window,pairs,iterations,min_us,p50_us,p90_us,p99_us,max_us,MB_per_s,"
+                << "Mmsg_per_s\n";
+        }
+    }
+
+    for (Test test : tests)
+        for (Method method : methods)
+        {
+            if (rank == 0)
+            {
+                cout << "\n" << TEST_NAMES[test] << " with " << METHOD_NAMES[method] << "\n";
+                cout << setw(10) << "bytes" << setw(10) << "min us" << setw(10) << "p50 us" << setw(10) << "p90 us";
+                cout << setw(10) << "p99 us" << setw(10) << "max us" << setw(12) << "MB/s" << setw(12) << "Mmsg/s";
+                cout << "\n";
+            }
+            Pair* p = (test == RATE) ? all : single;
+            int pairs_used = (test == RATE) ? num_pairs : 1;
+
+            for (long int bytes = min_bytes; bytes <= max_bytes; bytes *= 2)
+            {
+                int window = window_size(test, bytes);
+                double volume = (double)bytes * window;
+                double scale = (volume <= FULL_ITERATIONS_BYTES) ? 1.0 : FULL_ITERATIONS_BYTES / volume;
+                int iterations = max(10, (int)(max_iterations * scale));
+                int warmup = max(2, (int)(max_warmup * scale));
+
+                vector<double> samples = measure(p, test, method, bytes, iterations, warmup);
+                vector<double> gathered(rank == 0 ? (size_t)iterations * num_procs : 0);
+                MPI_Gather(samples.data(), iterations, MPI_DOUBLE, gathered.data(), iterations, MPI_DOUBLE, 0,
+                           MPI_COMM_WORLD);
+                if (rank != 0)
+                    continue;
+
+                // Samples of every pair's first rank
+                vector<double> sorted;
+                for (int r = 0; r < num_procs; ++r)
+                    if (r < half)
+                        sorted.insert(sorted.end(), gathered.begin() + (size_t)r * iterations,
+                                      gathered.begin() + (size_t)(r + 1) * iterations);
+                sorted.erase(remove_if(sorted.begin(), sorted.end(), [](double x) { return isnan(x); }),
+                             sorted.end());
+                sort(sorted.begin(), sorted.end());
+
+                double median = percentile(sorted, 0.5);
+                double messages = (double)window * pairs_used * (test == BIBANDWIDTH ? 2 : 1);
+                double bandwidth = messages * bytes / median / 1e6, rate = messages / median / 1e6;
+                double stats[5] = {sorted.front(), median, percentile(sorted, 0.9), percentile(sorted, 0.99),
+                                   sorted.back()};
+
+                cout << setw(10) << bytes << fixed << setprecision(2);
+                for (double s : stats)
+                    cout << setw(10) << s * 1e6;
+                cout << setw(12) << setprecision(1) << bandwidth << setw(12) << setprecision(4) << rate << "\n";
+                if (csv.is_open())
+                {
+                    csv << TEST_NAMES[test] << "," << METHOD_NAMES[method] << "," << bytes << "," << window << ","
+                        << pairs_used << "," << iterations;
+                    for (double s : stats)
+                        csv << "," << s * 1e6;
+                    csv << "," << bandwidth << "," << rate << "\n";
+                }
+            }
+        }
+
+    for (int c = 0; c < 2; ++c)
+        if (comms[c] != MPI_COMM_NULL)
+        {
+            MPI_Win_free(&pairs[c].win);
+            MPI_Comm_free(&comms[c]);
+        }
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+    Distributed C = A B with SUMMA (van de Geijn and Watts, 1997).
+
+    Usage: summa [N] [block_size] [gemm|dgemm] [pipelined|blocking]
+
+    The ranks form a P_r x P_c grid (MPI_Dims_create and MPI_Cart_create) and
+    the N x N matrices are distributed block-cyclically in blocks of
+    block_size x block_size: block (I, J) lives on grid position
+    (I mod P_r, J mod P_c), so every rank holds a scattered, evenly sized
+    share of every part of the matrix.  For every block column k of A and
+    block row k of B
+        - the grid column that owns column k of A broadcasts its part of it
+          along each grid row,
+        - the grid row that owns row k of B broadcasts its part along each
+          grid column, and
+        - every rank adds the product of the two panels it received to its
+          part of C with a local gemm (gemm.h or the system dgemm).
+    Pipelined, the broadcasts of step k + 1 are started with MPI_Ibcast before
+    the multiply of step k, so communication overlaps with computation;
+    blocking waits for each step's panels before computing.
+
+    A and B are generated from Philox streams by global index, so no rank
+    ever holds a whole matrix and every rank can compute any exact entry of
+    C to check its own.
+*/
+
+// MPI Library
+#include "mpi.h"
+
+// Blocked matrix multiply for the local products
+#include "gemm.h"
+// Counter-based random numbers for the matrices
+#include "philox.h"
+
+// System BLAS
+#include <cblas.h>
+
+// Standard IO libraries
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <math.h>
+
+uint64_t const SEED = 2012;
+
+// Rows (or columns) of n in blocks of nb held by position p of np
+int local_size(int n, int nb, int p, int np)
+{
+    int blocks = n / nb, size = (blocks / np) * nb, extra = blocks % np;
+    if (p < extra)
+        size += nb;
+    else if (p == extra)
+        size += n % nb;
+    return size;
+}
+
+// Global index of local index l at position p of np
+int global_index(int l, int nb, int p, int np)
+{
+    return ((l / nb) * np + p) * nb + l % nb;
+}
+
+double entry_a(int n, int i, int j) { return philox_double(SEED, 0, (uint64_t)i * n + j) - 0.5; }
+double entry_b(int n, int i, int j) { return philox_double(SEED, 1, (uint64_t)i * n + j) - 0.5; }
+
+int main(int argc, char* argv[])
+{
+    int num_procs, rank;
+
+    // Initialize MPI
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    int N = (argc > 1) ? stoi(argv[1]) : 1024;
+    int nb = (argc > 2) ? stoi(argv[2]) : 128;
+    bool use_dgemm = (argc > 3 && string(argv[3]) == "dgemm");
+    bool pipelined = !(argc > 4 && string(argv[4]) == "blocking");
+
+    // Process grid, with communicators for its rows and columns
+    int dims[2] = {0, 0}, periods[2] = {0, 0}, coords[2];
+    MPI_Dims_create(num_procs, 2, dims);
+    MPI_Comm grid, row_comm, column_comm;
+    MPI_Cart_create(MPI_COMM_WORLD, 2, dims, periods, 0, &grid);
+    MPI_Cart_coords(grid, rank, 2, coords);
+    int keep_column[2] = {0, 1}, keep_row[2] = {1, 0};
+    MPI_Cart_sub(grid, keep_column, &row_comm);
+    MPI_Cart_sub(grid, keep_row, &column_comm);
+    int my_row = coords[0], my_column = coords[1], grid_rows = dims[0], grid_columns = dims[1];
+
+    // Local parts, row-major
+    int m_local = local_size(N, nb, my_row, grid_rows);
+    int n_local = local_size(N, nb, my_column, grid_columns);
+    vector<double> A((size_t)m_local * n_local), B((size_t)m_local * n_local), C((size_t)m_local * n_local, 0.0);
+    for (int i = 0; i < m_local; ++i)
+    {
+        int gi = global_index(i, nb, my_row, grid_rows);
+        for (int j = 0; j < n_local; ++j)
+        {
+            int gj = global_index(j, nb, my_column, grid_columns);
+            A[(size_t)i * n_local + j] = entry_a(N, gi, gj);
+            B[(size_t)i * n_local + j] = entry_b(N, gi, gj);
+        }
+    }
+
+    if (rank == 0)
+    {
+        cout << "SUMMA for N = " << N << " in " << nb << " x " << nb << " blocks on a " << grid_rows << " x ";
+        cout << grid_columns << " grid, " << (use_dgemm ? "dgemm" : "gemm.h") << ", ";
+        cout << (pipelined ? "pipelined" : "blocking") << " broadcasts.\n";
+    }
+
+    // Two sets of panel buffers, one being received while the other is used
+    vector<double> a_panel[2], b_panel[2];
+    for (int s = 0; s < 2; ++s)
+    {
+        a_panel[s].resize((size_t)m_local * nb);
+        b_panel[s].resize((size_t)nb * n_local);
+    }
+    MPI_Request requests[2][2];
+    int num_steps = (N + nb - 1) / nb;
+
+    // Owners copy their part of block column k of A and block row k of B
+    // into the panels, then everyone joins the broadcasts
+    auto start_step = [&](int k, int s)
+    {
+        int width = min(nb, N - k * nb);
+        int a_owner = k % grid_columns, b_owner = k % grid_rows;
+        if (my_column == a_owner)
+        {
+            int offset = (k / grid_columns) * nb;
+            for (int i = 0; i < m_local; ++i)
+                for (int j = 0; j < width; ++j)
+                    a_panel[s][(size_t)i * width + j] = A[(size_t)i * n_local + offset + j];
+        }
+        if (my_row == b_owner)
+        {
+            int offset = (k / grid_rows) * nb;
+            for (int i = 0; i < width; ++i)
+                for (int j = 0; j < n_local; ++j)
+                    b_panel[s][(size_t)i * n_local + j] = B[(size_t)(offset + i) * n_local + j];
+        }
+        MPI_Ibcast(a_panel[s].data(), m_local * width, MPI_DOUBLE, a_owner, row_comm, &requests[s][0]);
+        MPI_Ibcast(b_panel[s].data(), width * n_local, MPI_DOUBLE, b_owner, column_comm, &requests[s][1]);
+    };
+
+    double communication_time = 0.0;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    if (pipelined)
+        start_step(0, 0);
+    for (int k = 0; k < num_steps; ++k)
+    {
+        int s = k % 2, width = min(nb, N - k * nb);
+        if (!pipelined)
+            start_step(k, s);
+        else if (k + 1 < num_steps)
+            start_step(k + 1, 1 - s);
+
+        double wait_start = MPI_Wtime();
+        MPI_Waitall(2, requests[s], MPI_STATUSES_IGNORE);
+        communication_time += MPI_Wtime() - wait_start;
+
+        if (m_local == 0 || n_local == 0)
+            continue;
+        if (use_dgemm)
+            cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, m_local, n_local, width, 1.0,
+                        a_panel[s].data(), width, b_panel[s].data(), n_local, 1.0, C.data(), n_local);
+        else
+            gemm(m_local, n_local, width, 1.0, a_panel[s].data(), width, b_panel[s].data(), n_local, 1.0,
+                 C.data(), n_local);
+    }
+    double elapsed = MPI_Wtime() - start_time, elapsed_max, communication_max;
+    MPI_Reduce(&elapsed, &elapsed_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&communication_time, &communication_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    // Check a few local entries against dot products of the generated rows
+    // and columns
+    double error = 0.0, error_max;
+    for (int sample = 0; sample < 4 && m_local > 0 && n_local > 0; ++sample)
+    {
+        int i = (int)(philox_double(SEED, 2 + rank, 2 * sample) * m_local);
+        int j = (int)(philox_double(SEED, 2 + rank, 2 * sample + 1) * n_local);
+        int gi = global_index(i, nb, my_row, grid_rows), gj = global_index(j, nb, my_column, grid_columns);
+        long double exact = 0.0;
+        for (int k = 0; k < N; ++k)
+            exact += (long double)entry_a(N, gi, k) * entry_b(N, k, gj);
+        error = fmax(error, fabs((double)(C[(size_t)i * n_local + j] - exact)));
+    }
+    MPI_Reduce(&error, &error_max, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        double gflops = 2.0 * N * N * (double)N / elapsed_max / 1e9;
+        cout << "N = " << N << " on " << num_procs << " ranks: " << elapsed_max << " s, " << gflops << " GFLOP/s, ";
+        cout << gflops / num_procs << " per rank, " << 100.0 * communication_max / elapsed_max;
+        cout << "% waiting for panels, max error " << error_max << ".\n";
+    }
+
+    MPI_Comm_free(&row_comm);
+    MPI_Comm_free(&column_comm);
+    MPI_Comm_free(&grid);
+    MPI_Finalize();
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+    Barrier latency microbenchmark.
+
+    Every thread calls the barrier in a tight loop and we report the average
+    time per barrier episode for
+        - the OpenMP runtime's barrier,
+        - the dissemination barrier from barrier.h inside an OpenMP team,
+        - the dissemination barrier with plain std::thread workers.
+    The thread count is doubled from 1 up to the requested maximum.
+
+    Usage: barrier_bench [max_threads] [repetitions]
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+// Spin/futex dissemination barrier
+#include "barrier.h"
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+double time_omp_barrier(int num_threads, int repetitions)
+{
+    double start_time = 0.0, end_time = 0.0;
+    #pragma omp parallel num_threads(num_threads)
+    {
+        #pragma omp barrier
+        #pragma omp master
+            start_time = omp_get_wtime();
+
+        for (int i = 0; i < repetitions; ++i)
+        {
+            #pragma omp barrier
+        }
+
+        #pragma omp master
+            end_time = omp_get_wtime();
+    }
+    return (end_time - start_time) / repetitions;
+}
+
+double time_dissemination_omp(int num_threads, int repetitions)
+{
+    DisseminationBarrier barrier(num_threads);
+    double start_time = 0.0, end_time = 0.0;
+    #pragma omp parallel num_threads(num_threads)
+    {
+        int thread_ID = omp_get_thread_num();
+
+        barrier.wait(thread_ID);
+        if (thread_ID == 0)
+            start_time = omp_get_wtime();
+
+        for (int i = 0; i < repetitions; ++i)
+            barrier.wait(thread_ID);
+
+        if (thread_ID == 0)
+            end_time = omp_get_wtime();
+    }
+    return (end_time - start_time) / repetitions;
+}
+
+double time_dissemination_threads(int num_threads, int repetitions)
+{
+    DisseminationBarrier barrier(num_threads);
+    chrono::steady_clock::time_point start_time, end_time;
+
+    auto worker = [&](int thread_ID)
+    {
+        barrier.wait(thread_ID);
+        if (thread_ID == 0)
+            start_time = chrono::steady_clock::now();
+
+        for (int i = 0; i < repetitions; ++i)
+            barrier.wait(thread_ID);
+
+        if (thread_ID == 0)
+            end_time = chrono::steady_clock::now();
+    };
+
+    vector<thread> threads;
+    for (int i = 1; i < num_threads; ++i)
+        threads.push_back(thread(worker, i));
+    worker(0);
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    return chrono::duration<double>(end_time - start_time).count() / repetitions;
+}
+
+int main(int argc, char* argv[])
+{
+    int max_threads = omp_get_max_threads();
+    int repetitions = 100000;
+
+    if (argc > 1)
+        max_threads = stoi(argv[1]);
+    if (argc > 2)
+        repetitions = stoi(argv[2]);
+
+    cout << "Barrier latency in ns, " << repetitions << " repetitions, spin count = ";
+    cout << DisseminationBarrier(max_threads).get_spin_count() << "\n";
+    cout << "threads   omp_barrier   dissemination(omp)   dissemination(std::thread)\n";
+
+    for (int num_threads = 1; num_threads <= max_threads; num_threads *= 2)
+    {
+        double t_omp = time_omp_barrier(num_threads, repetitions);
+        double t_dis = time_dissemination_omp(num_threads, repetitions);
+        double t_thr = time_dissemination_threads(num_threads, repetitions);
+
+        cout << num_threads << "   " << t_omp * 1e9 << "   " << t_dis * 1e9;
+        cout << "   " << t_thr * 1e9 << "\n";
+    }
+
+    return 0;
+}
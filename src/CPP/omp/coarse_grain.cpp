@@ -2,9 +2,15 @@
 // OpenMP library header
 #include <omp.h>
 
+// Per-thread padded slots with a tree combine
+#include "reduction.h"
+// Binned accumulators that sum independently of the thread count
+#include "reproducible_sum.h"
+
 // Standard io stream and namespace
 #include <iostream>
 #include <string>
+#include <vector>
 using namespace std;
 
 // Math library
@@ -12,19 +18,34 @@ using namespace std;
 
 int main(int argc, char* argv[])
 {
-    int const n = pow(2, 10);
-    double x[n], y[n];
+    int n = pow(2, 10);
+    if (argc > 3)
+        n = stoi(argv[3]);
+    vector<double> x(n), y(n);
     double norm, norm_thread, y_norm, y_norm_thread, true_norm;
     int num_threads, points_per_thread, thread_ID;
     int start_index, end_index;
+    double start_time, end_time;
+
+    // Usage: coarse_grain [num_threads] [tree|critical|repro] [n]
+    string method = "tree";
+    if (argc > 2)
+        method = argv[2];
+    bool use_critical = (method == "critical");
+    bool reproducible = (method == "repro");
+    ReproducibleSum norm_sum, y_norm_sum;
 
     num_threads = 1;
     #ifdef _OPENMP
         num_threads = 15;
+        if (argc > 1)
+            num_threads = stoi(argv[1]);
         omp_set_num_threads(num_threads);
         cout << "Using OpenMP with " << num_threads << " threads.\n";
     #endif
 
+    TreeReducer reducer(num_threads);
+
     points_per_thread = n / num_threads;
     cout << "Points per thread = " << points_per_thread << " / " << n << "\n";
 
@@ -35,6 +56,7 @@ int main(int argc, char* argv[])
     norm = 0.0;
     y_norm = 0.0;
 
+    start_time = omp_get_wtime();
     #pragma omp parallel private(norm_thread, start_index, end_index, thread_ID, y_norm_thread)
     {
 
@@ -51,30 +73,80 @@ int main(int argc, char* argv[])
         cout << output;
 
         norm_thread = 0.0;
-        for (int i = start_index; i < end_index; ++i)
-            norm_thread += fabs(x[i]);
-
-        #pragma omp critical
-            norm += norm_thread;
-
-        #pragma omp barrier
+        if (reproducible)
+        {
+            // Merging accumulators is exact, so the order threads enter the
+            // critical section in does not matter any more
+            ReproducibleSum norm_partial;
+            norm_partial.add_abs(&x[start_index], end_index - start_index);
+            #pragma omp critical
+                norm_sum.add(norm_partial);
+
+            #pragma omp barrier
+            norm_thread = norm_sum.value();
+            #pragma omp single nowait
+                norm = norm_thread;
+        }
+        else
+        {
+            for (int i = start_index; i < end_index; ++i)
+                norm_thread += fabs(x[i]);
+
+            if (use_critical)
+            {
+                #pragma omp critical
+                    norm += norm_thread;
+
+                // From here on norm_thread holds the full norm
+                #pragma omp barrier
+                norm_thread = norm;
+            }
+            else
+            {
+                // Every thread gets the same norm back, no barrier needed after
+                norm_thread = reducer.sum(thread_ID, norm_thread);
+                #pragma omp single nowait
+                    norm = norm_thread;
+            }
+        }
 
         y_norm_thread = 0.0;
         for (int i = start_index; i < end_index; ++i)
         {
-            y[i] = x[i] / norm;
+            y[i] = x[i] / norm_thread;
             y_norm_thread += fabs(y[i]);
         }
 
-        #pragma omp critical
-            y_norm += y_norm_thread;
-
-        #pragma omp barrier
+        if (reproducible)
+        {
+            ReproducibleSum y_norm_partial;
+            y_norm_partial.add_abs(&y[start_index], end_index - start_index);
+            #pragma omp critical
+                y_norm_sum.add(y_norm_partial);
+        }
+        else if (use_critical)
+        {
+            #pragma omp critical
+                y_norm += y_norm_thread;
+        }
+        else
+        {
+            y_norm_thread = reducer.sum(thread_ID, y_norm_thread);
+            #pragma omp single nowait
+                y_norm = y_norm_thread;
+        }
     }
+    end_time = omp_get_wtime();
 
-    true_norm = n * (n - 1) / 2;
+    true_norm = (double)n * (n - 1) / 2;
     cout << "Norm of x = " << norm << ", n (n - 1) / 2 = " << true_norm << ".\n";
-    cout << "Norm of y = " << y_norm << ".\n";
+    if (reproducible)
+        y_norm = y_norm_sum.value();
+    cout << "Norm of y = " << y_norm << " (" << hexfloat << y_norm << defaultfloat << ").\n";
+    // Read x, then read x, write y and read y in one pass
+    double elapsed = end_time - start_time;
+    cout << "Reduction with " << method;
+    cout << " took " << elapsed << " s, " << 3 * 8.0 * n / elapsed / 1e9 << " GB/s.\n";
 
     return 0;
 }
\ No newline at end of file
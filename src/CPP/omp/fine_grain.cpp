@@ -2,56 +2,102 @@
 // OpenMP library header
 #include <omp.h>
 
+// Binned accumulators that sum independently of the thread count
+#include "reproducible_sum.h"
+
 // Standard io stream and namespace
 #include <iostream>
+#include <string>
+#include <vector>
 using namespace std;
 
 // Math library
 #include <math.h>
 
-int main()
+// Usage: fine_grain [num_threads] [n] [naive|repro]
+int main(int argc, char* argv[])
 {
-    int const n = pow(2, 10) + 1;
-    int i, thread_ID, num_threads;
+    long int n = pow(2, 10) + 1;
+    long int i;
+    int thread_ID, num_threads;
 
-    double x[n], y[n];
-    double norm, true_x_norm, y_norm;
+    if (argc > 2)
+        n = stol(argv[2]);
+    bool reproducible = (argc > 3 && string(argv[3]) == "repro");
+    vector<double> x(n), y(n);
+    double norm, true_x_norm, y_norm, start_time;
 
     // Handle setting the number of threads
     num_threads = 1;
     #ifdef _OPENMP
         num_threads = 8;
+        if (argc > 1)
+            num_threads = stoi(argv[1]);
         omp_set_num_threads(num_threads);
         cout << "Using OpenMP with " << num_threads << ".\n";
     #endif
 
     // Initialize x vector
-    #pragma parallel for
+    #pragma omp parallel for
     for (i = 0; i < n; ++i)
         x[i] = (double)i;
 
     norm = 0.0;
     y_norm = 0.0;
 
-    #pragma omp parallel
+    start_time = omp_get_wtime();
+    if (!reproducible)
     {
-        #pragma omp for reduction(+ : norm)
-        for (i = 0; i < n; ++i)
-            norm = norm + fabs(x[i]);
+        #pragma omp parallel
+        {
+            #pragma omp for reduction(+ : norm)
+            for (i = 0; i < n; ++i)
+                norm = norm + fabs(x[i]);
 
-        #pragma omp barrier  // Not srtictly needed
+            #pragma omp barrier  // Not srtictly needed
 
-        #pragma omp for reduction(+ : y_norm)
-        for (i = 0; i < n; ++i)
+            #pragma omp for reduction(+ : y_norm)
+            for (i = 0; i < n; ++i)
+            {
+                y[i] = x[i] / norm;
+                y_norm = y_norm + fabs(y[i]);
+            }
+        }
+    }
+    else
+    {
+        // Same loops over blocks, the accumulators give the same bits no
+        // matter how the blocks end up distributed over the threads
+        long int const BLOCK = 1024;
+        long int num_blocks = (n + BLOCK - 1) / BLOCK;
+        ReproducibleSum norm_sum, y_norm_sum;
+        #pragma omp parallel
         {
-            y[i] = x[i] / norm;
-            y_norm = y_norm + fabs(y[i]);
+            #pragma omp for reduction(reproducible_sum : norm_sum)
+            for (long int b = 0; b < num_blocks; ++b)
+                norm_sum.add_abs(&x[b * BLOCK], min(BLOCK, n - b * BLOCK));
+
+            #pragma omp single
+                norm = norm_sum.value();
+
+            #pragma omp for reduction(reproducible_sum : y_norm_sum)
+            for (long int b = 0; b < num_blocks; ++b)
+            {
+                long int end = min(n, (b + 1) * BLOCK);
+                for (long int j = b * BLOCK; j < end; ++j)
+                    y[j] = x[j] / norm;
+                y_norm_sum.add_abs(&y[b * BLOCK], end - b * BLOCK);
+            }
         }
+        y_norm = y_norm_sum.value();
     }
 
-    true_x_norm = n * (n - 1) / 2;
+    double elapsed = omp_get_wtime() - start_time;
+
+    true_x_norm = (double)n * (n - 1) / 2;
     cout << "Norm of x = " << norm << ", n (n-1) / 2 = " << true_x_norm << ".\n";
-    cout << "Norm of y should be 1, is " << y_norm << ".\n";
+    cout << "Norm of y should be 1, is " << y_norm << " (" << hexfloat << y_norm << defaultfloat << ").\n";
+    cout << "OpenMP fine grain " << (reproducible ? "(repro)" : "(naive)") << " took " << elapsed << " s, " << 3 * 8.0 * n / elapsed / 1e9 << " GB/s.\n";
 
     return 0;
 }
\ No newline at end of file
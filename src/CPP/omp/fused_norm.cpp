@@ -0,0 +1,190 @@
+/*
+    Normalize a vector y = x / ||x||_1 and check that ||y||_1 = 1, comparing
+        three_pass - the loops of fine_grain.cpp: norm of x, y = x / norm,
+                     norm of y, each a separate pass over memory
+        fused      - norm of x in one pass, then y = x / norm and the norm of
+                     y in a second pass with streaming stores for y
+        online     - the fused kernels applied to chunks of x that are
+                     generated on the fly, so the vector is never stored
+    against the STREAM triad a = b + s * c on arrays of the same length, which
+    is about the best sustained bandwidth the machine will give us.
+
+    Usage: fused_norm [num_threads] [n] [chunk_size]
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+// Fused and streaming normalization kernels
+#include "norm_kernels.h"
+// Per-thread padded slots with a tree combine
+#include "reduction.h"
+
+// Standard io stream and namespace
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+int main(int argc, char* argv[])
+{
+    long int n = pow(2, 24);
+    long int chunk_size = pow(2, 20);
+    int num_threads = omp_get_max_threads();
+    int const REPETITIONS = 5;
+
+    if (argc > 1)
+        num_threads = stoi(argv[1]);
+    if (argc > 2)
+        n = stol(argv[2]);
+    if (argc > 3)
+        chunk_size = stol(argv[3]);
+    omp_set_num_threads(num_threads);
+    cout << "Using OpenMP with " << num_threads << " threads, n = " << n << ".\n";
+
+    vector<double> x(n), y(n);
+    double norm, y_norm, start_time, best;
+
+    // Initialize x, each thread touches the slice it will work on
+    #pragma omp parallel
+    {
+        long int begin, end;
+        thread_slice(n, begin, end);
+        for (long int i = begin; i < end; ++i)
+        {
+            x[i] = (double)i;
+            y[i] = 0.0;
+        }
+    }
+
+    // STREAM triad, best of several runs
+    {
+        vector<double> a(n), b(n), c(n);
+        #pragma omp parallel for schedule(static)
+        for (long int i = 0; i < n; ++i)
+        {
+            a[i] = 0.0;
+            b[i] = 1.0;
+            c[i] = 2.0;
+        }
+
+        best = 1e30;
+        for (int r = 0; r < REPETITIONS; ++r)
+        {
+            start_time = omp_get_wtime();
+            #pragma omp parallel for schedule(static)
+            for (long int i = 0; i < n; ++i)
+                a[i] = b[i] + 3.0 * c[i];
+            best = fmin(best, omp_get_wtime() - start_time);
+        }
+    }
+    double triad_bandwidth = 3 * 8.0 * n / best / 1e9;
+    cout << "STREAM triad: " << triad_bandwidth << " GB/s\n";
+
+    // Report the best time of a method as GB/s and fraction of triad
+    auto report = [&](string method, double seconds, double bytes)
+    {
+        double bandwidth = bytes / seconds / 1e9;
+        cout << method << ": ||x|| = " << norm << ", ||y|| = " << y_norm << ", ";
+        cout << seconds << " s, " << bandwidth << " GB/s, ";
+        cout << 100.0 * bandwidth / triad_bandwidth << "% of triad\n";
+    };
+
+    // Three passes as in fine_grain.cpp
+    best = 1e30;
+    for (int r = 0; r < REPETITIONS; ++r)
+    {
+        start_time = omp_get_wtime();
+        norm = 0.0;
+        y_norm = 0.0;
+        #pragma omp parallel
+        {
+            #pragma omp for schedule(static) reduction(+ : norm)
+            for (long int i = 0; i < n; ++i)
+                norm += fabs(x[i]);
+
+            #pragma omp for schedule(static)
+            for (long int i = 0; i < n; ++i)
+                y[i] = x[i] / norm;
+
+            #pragma omp for schedule(static) reduction(+ : y_norm)
+            for (long int i = 0; i < n; ++i)
+                y_norm += fabs(y[i]);
+        }
+        best = fmin(best, omp_get_wtime() - start_time);
+    }
+    report("three_pass", best, 4 * 8.0 * n);
+
+    // One read pass and one fused read/stream pass
+    TreeReducer reducer(num_threads);
+    best = 1e30;
+    for (int r = 0; r < REPETITIONS; ++r)
+    {
+        start_time = omp_get_wtime();
+        #pragma omp parallel
+        {
+            int thread_ID = omp_get_thread_num();
+            long int begin, end;
+            thread_slice(n, begin, end);
+
+            double thread_norm = reducer.sum(thread_ID, l1_norm(x.data(), begin, end));
+            double thread_y_norm = normalize(x.data(), y.data(), begin, end, thread_norm);
+            stream_fence();
+            thread_y_norm = reducer.sum(thread_ID, thread_y_norm);
+
+            if (thread_ID == 0)
+            {
+                norm = thread_norm;
+                y_norm = thread_y_norm;
+            }
+        }
+        best = fmin(best, omp_get_wtime() - start_time);
+    }
+    report("fused", best, 3 * 8.0 * n);
+
+    // Online - x arrives chunk by chunk (here it is generated) and is gone
+    // after each pass, only a chunk of x and of y is ever in memory
+    {
+        vector<double> x_chunk(chunk_size), y_chunk(chunk_size);
+        auto generate = [&](long int first, long int length)
+        {
+            #pragma omp parallel
+            {
+                long int begin, end;
+                thread_slice(length, begin, end);
+                for (long int i = begin; i < end; ++i)
+                    x_chunk[i] = (double)(first + i);
+            }
+        };
+
+        best = 1e30;
+        for (int r = 0; r < REPETITIONS; ++r)
+        {
+            start_time = omp_get_wtime();
+            OnlineNormalizer normalizer;
+            for (long int first = 0; first < n; first += chunk_size)
+            {
+                long int length = min(chunk_size, n - first);
+                generate(first, length);
+                normalizer.accumulate(x_chunk.data(), length);
+            }
+            for (long int first = 0; first < n; first += chunk_size)
+            {
+                long int length = min(chunk_size, n - first);
+                generate(first, length);
+                normalizer.normalize(x_chunk.data(), y_chunk.data(), length);
+            }
+            norm = normalizer.get_norm();
+            y_norm = normalizer.get_y_norm();
+            best = fmin(best, omp_get_wtime() - start_time);
+        }
+
+        // Count the chunk writes of the generator as well
+        report("online", best, 5 * 8.0 * n);
+    }
+
+    return 0;
+}
@@ -1,15 +1,33 @@
+/*
+    Hello from every thread, and where each one runs.
+
+    Usage: hello_world [layout.csv]
+
+    Every thread reports its CPU with the core, socket, NUMA node and L3
+    cache of it and the CPUs it is allowed on, followed by warnings about
+    threads sharing CPUs or cores and threads that are not pinned.  Try
+    OMP_PROC_BIND=close OMP_PLACES=cores.  The layout is also written to
+    layout.csv, in the format of topology.h, for solvers that pin their
+    threads from it.
+*/
 
 // OpenMP library header
 #include <omp.h>
 
+// Core, socket, NUMA node and cache of every thread
+#include "topology.h"
+
 // Standard io stream and namespace
+#include <fstream>
 #include <iostream>
 #include <string>
+#include <vector>
 using namespace std;
 
-int main() 
+int main(int argc, char* argv[])
 {
     int total_threads;
+    vector<Placement> layout;
 
     // Fork into threads
     #pragma omp parallel
@@ -19,6 +37,7 @@ int main()
         if (thread_ID == 0)
         {
             total_threads = omp_get_num_threads();
+            layout.resize(total_threads);
         }
         #pragma omp barrier
 
@@ -27,7 +46,21 @@ int main()
         // condition
         string output = "Hello, World from " + to_string(thread_ID) + " of " + to_string(total_threads) + "!\n";
         cout << output;
+
+        layout[thread_ID] = current_placement(0, thread_ID);
+    }
+
+    cout << "\n";
+    print_layout(cout, layout);
+    for (string const& problem : check_layout(layout))
+        cout << "Warning: " << problem << "\n";
+
+    if (argc > 1)
+    {
+        ofstream csv(argv[1]);
+        write_layout(csv, layout);
+        cout << "Layout written to " << argv[1] << ".\n";
     }
 
     return 0;
-}
\ No newline at end of file
+}
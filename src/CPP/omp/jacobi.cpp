@@ -6,6 +6,9 @@
     using Jacobi iterations.
 */
 
+// Vectorized exp on arrays
+#include "vmath.h"
+
 #include <iostream>
 #include <fstream>
 using namespace std;
@@ -38,9 +41,9 @@ int main()
     for (int i = 0; i < N + 2; ++i)
     {
         x[i] = (double) i * dx + a;
-        f[i] = exp(x[i]);
         u[i] = alpha + x[i] * (beta - alpha);
     }
+    vec_exp(x, f, N + 2);
 
     // Primary algorithm loop
     k = 0;
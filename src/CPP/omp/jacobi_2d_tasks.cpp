@@ -0,0 +1,211 @@
+/*
+    Solve the Poisson problem
+        u_{xx} + u_{yy} = f(x, y)   x \in \Omega = [0, pi] x [0, pi]
+    with
+        u(0, y) = u(pi, y) = 0
+        u(x, 0) = 2 sin x
+        u(x, pi) = -2 sin x
+    and
+        f(x, y) = -20 sin x cos 3 y
+    using Jacobi iterations and OpenMP tasks with dependencies.
+
+    This is the two dimensional version of jacobi_tasks.cpp: the interior is
+    split into square tiles and each tile update depends on the tile and its
+    four edge neighbours from the previous iteration.  See that file for how
+    the alternating arrays and the windowed convergence check work.
+
+    Usage: jacobi_2d_tasks [num_threads] [tile_size] [check_interval]
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+#include <iostream>
+#include <fstream>
+#include <string>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+int main(int argc, char* argv[])
+{
+    // Problem paramters
+    double const pi = 3.141592654;
+    double const a = 0.0, b = pi;
+
+    // Numerical parameters
+    long int const MAX_ITERATIONS = pow(2, 16);
+    int const PRINT_INTERVAL = 100;
+    int N;
+    long int k;
+    double x, y, dx, dy, tolerance, du_max;
+
+    // Discretization
+    N = 100;
+    dx = (b - a) / ((double)(N + 1));
+    dy = dx;
+    tolerance = 0.1 * pow(dx, 2);
+
+    // Task decomposition
+    int num_threads, tile_size, num_tiles, check_interval;
+    double start_time, end_time;
+    num_threads = 8;
+    tile_size = 25;
+    check_interval = 10;
+    if (argc > 1)
+        num_threads = stoi(argv[1]);
+    if (argc > 2)
+        tile_size = stoi(argv[2]);
+    if (argc > 3)
+        check_interval = stoi(argv[3]);
+    num_tiles = (N + tile_size - 1) / tile_size;
+
+    omp_set_num_threads(num_threads);
+    cout << "Using OpenMP with " << num_threads << " threads and ";
+    cout << num_tiles << " x " << num_tiles << " tiles of " << tile_size << " points.\n";
+
+    // Work arrays stored so that (x_i, y_j) is u[i * (N + 2) + j], u[0] holds
+    // even and u[1] odd iterations
+    int const M = N + 2;
+    double *f = new double[M * M];
+    double *u[2] = {new double[M * M], new double[M * M]};
+
+    // Dependency objects for tiles (1..num_tiles)^2 with a ring of unused
+    // entries standing in for the boundaries
+    int const T = num_tiles + 2;
+    char *dep[2] = {new char[T * T], new char[T * T]};
+
+    double *tile_du[2] = {new double[T * T], new double[T * T]};
+    double window_du[2];
+    char check_dep[2];
+
+    // Initialize arrays - fill boundaries
+    for (int i = 0; i < M; ++i)
+    {
+        x = dx * (double) i + a;
+        for (int j = 0; j < M; ++j)
+        {
+            y = dy * (double) j + a;
+            f[i * M + j] = -20.0 * sin(x) * cos(3.0 * y);
+            u[0][i * M + j] = 1.0;
+        }
+        u[0][i * M + 0] = 2.0 * sin(x);
+        u[0][i * M + N + 1] = -2.0 * sin(x);
+    }
+    for (int j = 0; j < M; ++j)
+    {
+        u[0][0 * M + j] = 0.0;
+        u[0][(N + 1) * M + j] = 0.0;
+    }
+    for (int i = 0; i < M * M; ++i)
+        u[1][i] = u[0][i];
+
+    // Primary algorithm loop
+    k = 0;
+    du_max = 0.0;
+    start_time = omp_get_wtime();
+    #pragma omp parallel
+    #pragma omp single
+    {
+        long int window;
+        for (window = 0; ; ++window)
+        {
+            int w = window % 2;
+            for (int n = 0; n < check_interval; ++n)
+            {
+                long int iteration = window * check_interval + n;
+                int p = iteration % 2, q = 1 - p;
+                bool last = (n == check_interval - 1);
+
+                for (int ti = 1; ti <= num_tiles; ++ti)
+                {
+                    for (int tj = 1; tj <= num_tiles; ++tj)
+                    {
+                        int t = ti * T + tj;
+                        #pragma omp task firstprivate(ti, tj, t, p, q, w, last) \
+                                         depend(in: dep[p][t], dep[p][t - T], dep[p][t + T], dep[p][t - 1], dep[p][t + 1]) \
+                                         depend(out: dep[q][t])
+                        {
+                            int i_start = (ti - 1) * tile_size + 1, i_end = min(ti * tile_size, N);
+                            int j_start = (tj - 1) * tile_size + 1, j_end = min(tj * tile_size, N);
+                            double *u_old = u[p], *u_new = u[q];
+
+                            double du = 0.0;
+                            for (int i = i_start; i < i_end + 1; ++i)
+                            {
+                                for (int j = j_start; j < j_end + 1; ++j)
+                                {
+                                    int c = i * M + j;
+                                    u_new[c] = 0.25 * (u_old[c - M] + u_old[c + M] + u_old[c - 1] + u_old[c + 1] - pow(dx, 2) * f[c]);
+                                    du = fmax(du, fabs(u_new[c] - u_old[c]));
+                                }
+                            }
+                            if (last)
+                                tile_du[w][t] = du;
+                        }
+                    }
+                }
+            }
+
+            // The last iteration of this window wrote into u[r], the iterator
+            // covers whole rows of the dependency array so the unused
+            // boundary entries are simply never written
+            int r = ((window + 1) * check_interval) % 2;
+            #pragma omp task firstprivate(w, r) \
+                             depend(iterator(t = T:(num_tiles + 1) * T), in: dep[r][t]) \
+                             depend(out: check_dep[w])
+            {
+                window_du[w] = 0.0;
+                for (int ti = 1; ti <= num_tiles; ++ti)
+                    for (int tj = 1; tj <= num_tiles; ++tj)
+                        window_du[w] = fmax(window_du[w], tile_du[w][ti * T + tj]);
+            }
+
+            // Wait for the previous window's check while this one runs
+            if (window > 0)
+            {
+                int v = 1 - w;
+                #pragma omp taskwait depend(in: check_dep[v])
+
+                if ((window * check_interval) / PRINT_INTERVAL != ((window - 1) * check_interval) / PRINT_INTERVAL)
+                {
+                    string output = "After " + to_string(window * check_interval);
+                    output += " iterations, du_max = " + to_string(window_du[v]) + "\n";
+                    cout << output;
+                }
+
+                if (window_du[v] < tolerance || (window + 1) * check_interval >= MAX_ITERATIONS)
+                    break;
+            }
+        }
+
+        #pragma omp taskwait
+        k = (window + 1) * check_interval;
+        du_max = window_du[window % 2];
+    }
+    end_time = omp_get_wtime();
+
+    cout << "Jacobi with tasks took " << k << " iterations and " << end_time - start_time << " s.\n";
+
+    // Check for failure
+    if (du_max >= tolerance)
+    {
+        cout << "*** Jacobi failed to converge!\n";
+        cout << "***   Reached du_max = " << du_max << "\n";
+        cout << "***   Tolerance = " << tolerance << "\n";
+        return 1;
+    }
+
+    // Write each row from bottom to top
+    ofstream fp("jacobi_0.txt");
+    for (int j = 0; j < M; ++j)
+    {
+        for (int i = 0; i < M; ++i)
+            fp << u[k % 2][i * M + j] << " ";
+        fp << "\n";
+    }
+    fp.close();
+
+    return 0;
+}
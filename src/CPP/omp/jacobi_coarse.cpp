@@ -4,19 +4,33 @@
     with 
         u(a) = alpha, u(b) = beta
     using Jacobi iterations and OpenMP using fine grain parallelism.
+
+    With a file name every thread's copy, barrier, sweep and reduction of
+    every iteration that is a multiple of stride are written there as a
+    trace (trace.h), to be opened in chrome://tracing or ui.perfetto.dev.
 */
 
 // OpenMP library header
 #include <omp.h>
 
+// Per-thread padded slots with a tree combine
+#include "reduction.h"
+// Spin/futex dissemination barrier
+#include "barrier.h"
+// Vectorized exp on arrays
+#include "vmath.h"
+// Per-thread timelines
+#include "trace.h"
+
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 using namespace std;
 
 // Math library
 #include <math.h>
 
-int main()
+int main(int argc, char* argv[])
 {
     // Problem parameters
     double const a = 0.0, b = 1.0, alpha = 0.0, beta = 3.0;
@@ -40,17 +54,56 @@ int main()
 
     // OpenMP
     int num_threads, thread_N, start_index, end_index, thread_ID;
-    double du_max_thread;
+    double du_max_thread, start_time, end_time;
     string output;
+
+    // Usage: jacobi_coarse [num_threads] [tree|critical|atomic|async] [omp|dissemination] [trace.json] [stride]
+    bool use_critical = (argc > 2 && string(argv[2]) == "critical");
+    bool use_atomic = (argc > 2 && string(argv[2]) == "atomic");
+    bool use_async = (argc > 2 && string(argv[2]) == "async");
+    bool use_dissemination = (argc > 3 && string(argv[3]) == "dissemination");
+
     num_threads = 1;
     #ifdef _OPENMP
         num_threads = 8;
+        if (argc > 1)
+            num_threads = stoi(argv[1]);
         omp_set_num_threads(num_threads);
         cout << "Using OpenMP with " << num_threads << " threads.\n";
     #endif
 
+    // Reduction of du_max, either through the tree reducer or through a
+    // critical section or a compare-exchange loop into one of two alternating
+    // shared values.  The alternation lets a thread reset next iteration's
+    // value while slower threads are still reading this one.
+    TreeReducer reducer(num_threads);
+    double du_max_shared[2] = {0.0, 0.0};
+    atomic<double> du_max_atomic[2];
+    du_max_atomic[0].store(0.0);
+    du_max_atomic[1].store(0.0);
+
+    // Barrier used inside the iteration loop
+    OmpBarrier omp_barrier;
+    DisseminationBarrier dissemination_barrier(num_threads);
+
+    // Tracing is off without a file
+    enum Event { COPY, BARRIER, SWEEP, REDUCE };
+    string trace_file = (argc > 4) ? argv[4] : "";
+    long int stride = (argc > 5) ? stol(argv[5]) : 1;
+    Tracer tracer({"copy", "barrier", "sweep", "reduce"}, num_threads, 1 << 16, trace_file.empty() ? 0 : stride);
+
+    // Asynchronous mode - per-thread convergence flags, a request for everyone
+    // to stop and verify, and the number of sweeps each thread made
+    int const ASYNC_CHECK_INTERVAL = 100;
+    vector<padded<atomic<bool>>> converged(num_threads);
+    atomic<bool> stop(false), out_of_iterations(false);
+    vector<int> sweeps(num_threads);
+    for (int t = 0; t < num_threads; ++t)
+        converged[t].value.store(false);
+
     // Parallel section
     k = 0;
+    start_time = omp_get_wtime();
     #pragma omp parallel private(output, thread_ID, du_max_thread, thread_N, start_index, end_index)
     {
         thread_ID = omp_get_thread_num();
@@ -68,9 +121,9 @@ int main()
         for (int i = start_index; i < end_index + 1; ++i)
         {
             x[i] = (double) i * dx + a;
-            f[i] = exp(x[i]);
             u[i] = alpha + x[i] * (beta - alpha);   
         }
+        vec_exp(&x[start_index], &f[start_index], end_index - start_index + 1);
 
         // Fix up end points
         #pragma omp single nowait
@@ -85,44 +138,200 @@ int main()
             u_old[N + 1] = u[N + 1];
         }
 
-        // Primary algorithm loop
-        while (k < MAX_ITERATIONS)
+        // One synchronous Jacobi iteration over this thread's points, returns
+        // du_max over the whole domain
+        auto barrier_wait = [&]()
         {
-            for (int i = start_index; i < end_index + 1; ++i)
-                u_old[i] = u[i];
+            if (use_dissemination)
+                dissemination_barrier.wait(thread_ID);
+            else
+                omp_barrier.wait(thread_ID);
+        };
 
-            #pragma omp barrier
+        auto jacobi_sweep = [&](int iteration) -> double
+        {
+            {
+                TraceScope scope(tracer, thread_ID, COPY);
+                for (int i = start_index; i < end_index + 1; ++i)
+                    u_old[i] = u[i];
+            }
 
-            du_max_thread = 0.0;
-            for (int i = start_index; i < end_index + 1; ++i)
             {
-                u[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
-                du_max_thread = fmax(du_max_thread, fabs(u[i] - u_old[i]));
+                TraceScope scope(tracer, thread_ID, BARRIER);
+                barrier_wait();
             }
-            
-            du_max = 0.0;
-            #pragma omp critical
+
+            double du = 0.0;
             {
-                du_max = fmax(du_max, du_max_thread);
+                TraceScope scope(tracer, thread_ID, SWEEP);
+                for (int i = start_index; i < end_index + 1; ++i)
+                {
+                    u[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
+                    du = fmax(du, fabs(u[i] - u_old[i]));
+                }
             }
 
-            #pragma omp barrier
+            TraceScope scope(tracer, thread_ID, REDUCE);
+            if (use_critical)
+            {
+                #pragma omp single nowait
+                    du_max_shared[(iteration + 1) % 2] = 0.0;
 
-            #pragma omp single nowait
+                #pragma omp critical
+                    du_max_shared[iteration % 2] = fmax(du_max_shared[iteration % 2], du);
+
+                barrier_wait();
+                return du_max_shared[iteration % 2];
+            }
+            else if (use_atomic)
+            {
+                #pragma omp single nowait
+                    du_max_atomic[(iteration + 1) % 2].store(0.0, memory_order_relaxed);
+
+                atomic_max(du_max_atomic[iteration % 2], du);
+
+                barrier_wait();
+                return du_max_atomic[iteration % 2].load(memory_order_relaxed);
+            }
+            else if (use_dissemination)
+                return reducer.max(thread_ID, du, dissemination_barrier);
+            else
+                return reducer.max(thread_ID, du, omp_barrier);
+        };
+
+        // Primary algorithm loop - every thread keeps its own count so that
+        // all of them agree on when to stop without further synchronization
+        int iteration = 0;
+        if (!use_async)
+        {
+            while (iteration < MAX_ITERATIONS)
             {
-                if (k%PRINT_INTERVAL == 0)
+                tracer.set_iteration(thread_ID, iteration);
+                du_max_thread = jacobi_sweep(iteration);
+
+                if (thread_ID == 0 && iteration % PRINT_INTERVAL == 0)
                 {
-                    output = "After " + to_string(k + 1);
-                    output += " iterations, du_max = " + to_string(du_max) + "\n"; 
+                    output = "After " + to_string(iteration + 1);
+                    output += " iterations, du_max = " + to_string(du_max_thread) + "\n"; 
                     cout << output;
                 }
-                k++;
+
+                if (du_max_thread < tolerance)
+                    break;
+
+                iteration++;
             }
+        }
+        else
+        {
+            // Asynchronous relaxation - sweep our points over and over using
+            // whatever values our neighbours last wrote to the cells next to
+            // ours.  Only the two cells at the edges of each thread's range
+            // are ever read by another thread so only those are accessed
+            // atomically.  u_old holds our previous sweep.
+            barrier_wait();
 
-            if (du_max < tolerance)
-                break;
+            int num_verifications = 0;
+            while (true)
+            {
+                tracer.set_iteration(thread_ID, iteration);
+                double du = 0.0;
+                {
+                    TraceScope scope(tracer, thread_ID, SWEEP);
+                    for (int i = start_index; i < end_index + 1; ++i)
+                        u_old[i] = u[i];
+
+                    double left, right;
+                    #pragma omp atomic read
+                        left = u[start_index - 1];
+                    #pragma omp atomic read
+                        right = u[end_index + 1];
+
+                    for (int i = start_index; i < end_index + 1; ++i)
+                    {
+                        double u_left = (i == start_index) ? left : u_old[i - 1];
+                        double u_right = (i == end_index) ? right : u_old[i + 1];
+                        double u_new = 0.5 * (u_left + u_right - pow(dx, 2) * f[i]);
+                        du = fmax(du, fabs(u_new - u_old[i]));
+
+                        if (i == start_index || i == end_index)
+                        {
+                            #pragma omp atomic write
+                                u[i] = u_new;
+                        }
+                        else
+                            u[i] = u_new;
+                    }
+                }
+                iteration++;
+
+                if (thread_ID == 0 && iteration % PRINT_INTERVAL == 0)
+                {
+                    output = "After " + to_string(iteration);
+                    output += " sweeps, local du_max = " + to_string(du) + "\n";
+                    cout << output;
+                }
+
+                // Publish whether we look converged and every so often check
+                // whether everyone does
+                converged[thread_ID].value.store(du < tolerance, memory_order_relaxed);
+                if (iteration >= MAX_ITERATIONS)
+                    out_of_iterations.store(true);
+                if (iteration % ASYNC_CHECK_INTERVAL == 0 || iteration >= MAX_ITERATIONS)
+                {
+                    bool all_converged = true;
+                    for (int t = 0; t < num_threads; ++t)
+                        all_converged = all_converged && converged[t].value.load(memory_order_relaxed);
+                    if (all_converged || iteration >= MAX_ITERATIONS)
+                        stop.store(true);
+                }
+
+                // The flags were read at different times so they only suggest
+                // convergence.  Stop everyone and confirm with one synchronous
+                // sweep on a consistent state, resume if it fails.
+                if (stop.load(memory_order_relaxed))
+                {
+                    barrier_wait();
+                    du_max_thread = jacobi_sweep(num_verifications++);
+                    if (du_max_thread < tolerance || out_of_iterations.load())
+                        break;
+
+                    converged[thread_ID].value.store(false, memory_order_relaxed);
+                    #pragma omp single
+                        stop.store(false);
+                }
+            }
+
+            sweeps[thread_ID] = iteration;
+            barrier_wait();
+            #pragma omp single nowait
+            {
+                output = "Asynchronous sweeps per thread between " + to_string(*min_element(sweeps.begin(), sweeps.end()));
+                output += " and " + to_string(*max_element(sweeps.begin(), sweeps.end()));
+                output += ", " + to_string(num_verifications) + " synchronous verifications\n";
+                cout << output;
+            }
         }
 
+        if (thread_ID == 0)
+        {
+            k = iteration;
+            du_max = du_max_thread;
+        }
+    }
+    end_time = omp_get_wtime();
+
+    if (use_async)
+        cout << "Jacobi with asynchronous relaxation and ";
+    else
+        cout << "Jacobi with " << (use_critical ? "critical" : use_atomic ? "atomic" : "tree") << " reduction and ";
+    cout << (use_dissemination ? "dissemination" : "omp") << " barrier";
+    cout << " took " << k << " iterations and " << end_time - start_time << " s.\n";
+
+    if (tracer.enabled())
+    {
+        tracer.write(trace_file);
+        cout << "Trace written to " << trace_file << ".\n";
     }
 
     // Check for failure
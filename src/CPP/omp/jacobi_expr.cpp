@@ -0,0 +1,118 @@
+/*
+    Solve the Poisson problem
+        u_{xx} = f(x)   x \in [a, b]
+    with
+        u(a) = \alpha, u(b) = \beta
+    using Jacobi iterations, with the sweep written as array expressions.
+
+    Usage: jacobi_expr [num_threads] [expr|loops]
+
+    "loops" runs the same sweep as hand written OpenMP loops, so the two
+    timings show what the expression templates cost.
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+// Expression templates, each statement one fused parallel loop
+#include "expr.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+int main(int argc, char* argv[])
+{
+    using namespace expr;
+
+    // Problem parameters
+    double const a = 0.0, b = 1.0, alpha = 0.0, beta = 3.0;
+
+    // Numerical parameters
+    int const MAX_ITERATIONS = pow(2,16), PRINT_INTERVAL = 100;
+
+    int num_threads = (argc > 1) ? stoi(argv[1]) : 1;
+    string method = (argc > 2) ? argv[2] : "expr";
+    omp_set_num_threads(num_threads);
+
+    // Numerical discretization
+    int N, k;
+    double dx, tolerance, du_max;
+    N = 100;
+    dx = (b - a) / (N + 1);
+    tolerance = 0.1 * pow(dx, 2);
+
+    // Work arrays
+    Array x(N + 2), u(N + 2), u_old(N + 2), f(N + 2);
+
+    // Initialize arrays including initial guess
+    x = dx * index() + a;
+    u = alpha + x * (beta - alpha);
+    u_old = u;
+    f = exp(x);
+
+    // Primary algorithm loop
+    double start_time = omp_get_wtime();
+    k = 0;
+    while (k < MAX_ITERATIONS)
+    {
+        if (method == "expr")
+        {
+            // Only the interior changes, so swapping keeps the boundary values
+            swap(u, u_old);
+            u.range(1, N + 1) = 0.5 * (shift(u_old, -1) + shift(u_old, 1) - dx * dx * f);
+            du_max = max(abs(u - u_old));
+        }
+        else
+        {
+            double* un = u.data();
+            double* uo = u_old.data();
+            double* fs = f.data();
+
+            #pragma omp parallel for simd
+            for (int i = 0; i < N + 2; ++i)
+                uo[i] = un[i];
+
+            du_max = 0.0;
+            #pragma omp parallel for simd reduction(max : du_max)
+            for (int i = 1; i < N + 1; ++i)
+            {
+                un[i] = 0.5 * (uo[i-1] + uo[i+1] - dx * dx * fs[i]);
+                du_max = fmax(du_max, fabs(un[i] - uo[i]));
+            }
+        }
+
+        if (k%PRINT_INTERVAL == 0)
+            cout << "After " << k + 1 << " iterations, du_max = " << du_max << ".\n";
+
+        if (du_max < tolerance)
+            break;
+
+        k++;
+    }
+    double elapsed = omp_get_wtime() - start_time;
+
+    // Check for failure
+    if (k >= MAX_ITERATIONS)
+    {
+        cout << "*** Jacobi failed to converge!\n";
+        cout << "***   Reached du_max = " << du_max << "\n";
+        cout << "***   Tolerance = " << tolerance << "\n";
+        return 1;
+    }
+
+    cout << method << ": " << num_threads << " threads, " << k + 1 << " iterations in ";
+    cout << elapsed << " s, " << elapsed / (k + 1) * 1e6 << " us per iteration.\n";
+
+    // Output Results
+    ofstream fp("jacobi_expr.txt");
+    for (int i = 0; i < N + 2; ++i)
+        fp << x[i] << " " << u[i] << "\n";
+    fp.close();
+
+    return 0;
+}
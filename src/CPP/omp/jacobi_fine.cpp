@@ -4,20 +4,39 @@
     with 
         u(a) = alpha, u(b) = beta
     using Jacobi iterations and OpenMP using fine grain parallelism.
+
+    In numa mode every loop uses the same static schedule, the arrays are
+    first written inside that schedule and each thread is pinned to a CPU, so
+    each thread's part of the arrays lives on its own NUMA node and stays
+    there.  Pinning is left to the OpenMP runtime if OMP_PLACES or
+    OMP_PROC_BIND are set, otherwise thread t goes to the t-th allowed CPU
+    (filling one node at a time), or to the CPU of thread t in a layout
+    written by hello_world (topology.h).  The achieved placement is reported
+    after initialization.
+
+    Usage: jacobi_fine [N] [default|numa] [layout.csv]
 */
 
 // OpenMP library header
 #include <omp.h>
 
+// Thread pinning and page placement queries
+#include "affinity.h"
+// Pinning layouts written by hello_world
+#include "topology.h"
+// Vectorized exp on arrays
+#include "vmath.h"
 
 #include <iostream>
 #include <fstream>
+#include <string>
+#include <vector>
 using namespace std;
 
 // Math library
 #include <math.h>
 
-int main()
+int main(int argc, char* argv[])
 {
     // Problem parameters
     double const a = 0.0, b = 1.0, alpha = 0.0, beta = 3.0;
@@ -30,6 +49,9 @@ int main()
     int N, k;
     double dx, tolerance, du_max;
     N = 1000;
+    if (argc > 1)
+        N = stoi(argv[1]);
+    bool use_numa = (argc > 2 && string(argv[2]) == "numa");
     dx = (b - a) / (N + 1);
     tolerance = 0.1 * pow(dx, 2);
 
@@ -48,25 +70,89 @@ int main()
         cout << "Using OpenMP with " << num_threads << " threads.\n";
     #endif
 
-    // Initialize arrays including initial guess
-    #pragma omp parallel for schedule(dynamic, 10)
+    // All loops below use schedule(runtime) so that the NUMA mode can switch
+    // every one of them to the same static partition
+    if (use_numa)
+    {
+        omp_set_schedule(omp_sched_static, 0);
+
+        if (omp_get_proc_bind() == omp_proc_bind_false)
+        {
+            vector<int> cpus = allowed_cpus();
+            if (argc > 3)
+            {
+                vector<int> layout = layout_cpus(argv[3], host_name(), 0);
+                if (!layout.empty())
+                    cpus = layout;
+            }
+            #pragma omp parallel
+            {
+                if (!cpus.empty())
+                    pin_to_cpu(cpus[omp_get_thread_num() % cpus.size()]);
+            }
+        }
+    }
+    else
+        omp_set_schedule(omp_sched_dynamic, 10);
+
+    // Initialize arrays including initial guess - this is where the pages are
+    // first touched
+    #pragma omp parallel for schedule(runtime)
     for (int i = 0; i < N + 2; ++i)
     {
         x[i] = (double) i * dx + a;
-        f[i] = exp(x[i]);
+        f[i] = x[i];
         u[i] = alpha + x[i] * (beta - alpha);
+        u_old[i] = u[i];
+    }
+
+    // f = exp(x) in place, a block of points per call to the vector exp
+    #pragma omp parallel for schedule(runtime)
+    for (int chunk = 0; chunk < N + 2; chunk += 256)
+        vec_exp(&f[chunk], &f[chunk], min(256, N + 2 - chunk));
+
+    // Report where each thread runs and what fraction of the pages of the part
+    // of u it owns under the static schedule are on its node
+    if (use_numa)
+    {
+        vector<string> report(num_threads);
+        #pragma omp parallel
+        {
+            int thread_ID = omp_get_thread_num();
+            int start_index = N + 2, end_index = 0;
+            #pragma omp for schedule(runtime) nowait
+            for (int i = 0; i < N + 2; ++i)
+            {
+                start_index = min(start_index, i);
+                end_index = i + 1;
+            }
+            int cpu = current_cpu(), node = cpu_node(cpu);
+
+            vector<int> nodes = page_nodes(&u[start_index], &u[end_index]);
+            int local = 0;
+            for (size_t p = 0; p < nodes.size(); ++p)
+                if (nodes[p] == node)
+                    local++;
+
+            report[thread_ID] = "Thread " + to_string(thread_ID) + " on CPU " + to_string(cpu);
+            report[thread_ID] += " (node " + to_string(node) + "), " + to_string(local) + " of ";
+            report[thread_ID] += to_string(nodes.size()) + " pages of its part of u are local\n";
+        }
+        for (int t = 0; t < num_threads; ++t)
+            cout << report[t];
     }
 
     // Primary algorithm loop
+    double start_time = omp_get_wtime();
     k = 0;
     while (k < MAX_ITERATIONS)
     {
-        #pragma omp parallel for schedule(dynamic, 10)
+        #pragma omp parallel for schedule(runtime)
         for (int i = 0; i < N + 2; ++i)
             u_old[i] = u[i];
 
         du_max = 0.0;
-        #pragma omp parallel for schedule(dynamic, 10) reduction(max : du_max)
+        #pragma omp parallel for schedule(runtime) reduction(max : du_max)
         for (int i = 1; i < N + 1; ++i)
         {
             u[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
@@ -82,6 +168,8 @@ int main()
         k++;
     }
 
+    cout << "Jacobi took " << k << " iterations and " << omp_get_wtime() - start_time << " s.\n";
+
     // Check for failure
     if (k >= MAX_ITERATIONS)
     {
@@ -0,0 +1,196 @@
+/*
+    Solve the Poisson problem
+        u_{xx} = f(x)   x \in [a, b]
+    with
+        u(a) = alpha, u(b) = beta
+    using Jacobi iterations and OpenMP tasks with dependencies.
+
+    The interior points are split into blocks and each update of a block for
+    one iteration is its own task.  That task only depends on the block and
+    its two neighbours from the previous iteration, so a block can run ahead
+    as soon as its neighbours are done instead of every thread waiting at a
+    barrier for the slowest one.
+
+    u alternates between two arrays (even and odd iterations) with a matching
+    pair of dependency arrays.  Overwriting the array that the previous
+    iteration read from is safe as the runtime orders an out dependency after
+    all earlier in dependencies on the same object.
+
+    Convergence is checked once every check_interval iterations by a task that
+    depends on all blocks of that iteration.  The next window of iterations is
+    queued before we wait on the check so the threads never run out of work;
+    once a check passes we let that window finish and stop.
+
+    Usage: jacobi_tasks [num_threads] [block_size] [check_interval]
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+// Vectorized exp on arrays
+#include "vmath.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+int main(int argc, char* argv[])
+{
+    // Problem parameters
+    double const a = 0.0, b = 1.0, alpha = 0.0, beta = 3.0;
+
+    // Numerical parameters
+    long int const MAX_ITERATIONS = pow(2,32);
+    int const PRINT_INTERVAL = 1000;
+
+    // Numerical discretization
+    int N;
+    long int k;
+    double dx, tolerance, du_max;
+    N = 1000;
+    dx = (b - a) / (N + 1);
+    tolerance = 0.1 * pow(dx, 2);
+
+    // Task decomposition
+    int num_threads, block_size, num_blocks, check_interval;
+    double start_time, end_time;
+    num_threads = 8;
+    block_size = 125;
+    check_interval = 100;
+    if (argc > 1)
+        num_threads = stoi(argv[1]);
+    if (argc > 2)
+        block_size = stoi(argv[2]);
+    if (argc > 3)
+        check_interval = stoi(argv[3]);
+    num_blocks = (N + block_size - 1) / block_size;
+
+    omp_set_num_threads(num_threads);
+    cout << "Using OpenMP with " << num_threads << " threads and ";
+    cout << num_blocks << " blocks of " << block_size << " points.\n";
+
+    // Work arrays, u[0] holds even and u[1] odd iterations
+    double *x = new double[N + 2];
+    double *f = new double[N + 2];
+    double *u[2] = {new double[N + 2], new double[N + 2]};
+
+    // Dependency objects for blocks 1 to num_blocks of each array, entries 0
+    // and num_blocks + 1 stand in for the boundaries and are never written
+    char *dep[2] = {new char[num_blocks + 2], new char[num_blocks + 2]};
+
+    // Change in each block over the last iteration of the current and previous
+    // window, and the maximum over all blocks
+    double *block_du[2] = {new double[num_blocks + 2], new double[num_blocks + 2]};
+    double window_du[2];
+    char check_dep[2];
+
+    // Initialize arrays including initial guess
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < N + 2; ++i)
+    {
+        x[i] = (double) i * dx + a;
+        u[0][i] = alpha + x[i] * (beta - alpha);
+        u[1][i] = u[0][i];
+    }
+    vec_exp(x, f, N + 2);
+    u[0][0] = u[1][0] = alpha;
+    u[0][N + 1] = u[1][N + 1] = beta;
+
+    // Primary algorithm loop - a single thread creates the tasks and the whole
+    // team executes them
+    k = 0;
+    du_max = 0.0;
+    start_time = omp_get_wtime();
+    #pragma omp parallel
+    #pragma omp single
+    {
+        long int window;
+        for (window = 0; ; ++window)
+        {
+            int w = window % 2;
+            for (int n = 0; n < check_interval; ++n)
+            {
+                long int iteration = window * check_interval + n;
+                int p = iteration % 2, q = 1 - p;
+                bool last = (n == check_interval - 1);
+
+                for (int block = 1; block <= num_blocks; ++block)
+                {
+                    #pragma omp task firstprivate(block, p, q, w, last) \
+                                     depend(in: dep[p][block - 1], dep[p][block], dep[p][block + 1]) \
+                                     depend(out: dep[q][block])
+                    {
+                        int start_index = (block - 1) * block_size + 1;
+                        int end_index = min(block * block_size, N);
+                        double *u_old = u[p], *u_new = u[q];
+
+                        double du = 0.0;
+                        for (int i = start_index; i < end_index + 1; ++i)
+                        {
+                            u_new[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
+                            du = fmax(du, fabs(u_new[i] - u_old[i]));
+                        }
+                        if (last)
+                            block_du[w][block] = du;
+                    }
+                }
+            }
+
+            // The last iteration of this window wrote into u[r]
+            int r = ((window + 1) * check_interval) % 2;
+            #pragma omp task firstprivate(w, r) \
+                             depend(iterator(block = 1:num_blocks + 1), in: dep[r][block]) \
+                             depend(out: check_dep[w])
+            {
+                window_du[w] = 0.0;
+                for (int block = 1; block <= num_blocks; ++block)
+                    window_du[w] = fmax(window_du[w], block_du[w][block]);
+            }
+
+            // Wait for the previous window's check while this one runs
+            if (window > 0)
+            {
+                int v = 1 - w;
+                #pragma omp taskwait depend(in: check_dep[v])
+
+                if ((window * check_interval) / PRINT_INTERVAL != ((window - 1) * check_interval) / PRINT_INTERVAL)
+                {
+                    string output = "After " + to_string(window * check_interval);
+                    output += " iterations, du_max = " + to_string(window_du[v]) + "\n";
+                    cout << output;
+                }
+
+                if (window_du[v] < tolerance || (window + 1) * check_interval >= MAX_ITERATIONS)
+                    break;
+            }
+        }
+
+        #pragma omp taskwait
+        k = (window + 1) * check_interval;
+        du_max = window_du[window % 2];
+    }
+    end_time = omp_get_wtime();
+
+    cout << "Jacobi with tasks took " << k << " iterations and " << end_time - start_time << " s.\n";
+
+    // Check for failure
+    if (du_max >= tolerance)
+    {
+        cout << "*** Jacobi failed to converge!\n";
+        cout << "***   Reached du_max = " << du_max << "\n";
+        cout << "***   Tolerance = " << tolerance << "\n";
+        return 1;
+    }
+
+    // Output Results
+    ofstream fp("jacobi_0.txt");
+    for (int i = 0; i < N + 2; ++i)
+        fp << x[i] << " " << u[k % 2][i] << "\n";
+    fp.close();
+
+    return 0;
+}
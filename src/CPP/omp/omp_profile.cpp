@@ -0,0 +1,240 @@
+/*
+    Where the threads of an OpenMP program wait, through the OMPT tool
+    interface of OpenMP 5.
+
+    Usage: OMP_TOOL_LIBRARIES=$PWD/libompprofile.so LD_PRELOAD=libomp.so.5 \
+               ./jacobi_coarse 8 critical omp
+
+    The runtime calls ompt_start_tool() of the library named in
+    OMP_TOOL_LIBRARIES when it starts up, and the tool registers callbacks
+    for the begin and end of
+        - the implicit task of every thread in a parallel region,
+        - work-sharing loops,
+        - waiting in barriers, implicit (end of a parallel region or of a
+          work-sharing construct) and explicit (#pragma omp barrier),
+        - waiting for critical sections and holding them, and
+        - waiting for locks, atomics and ordered regions.
+    When the runtime shuts down every thread's totals are printed to stderr:
+    the time in parallel regions, split into waiting and compute (the rest),
+    and the time in loops and held critical sections.  A thread that waits
+    most of the time in barriers has too little work or too much imbalance;
+    one that waits for critical sections needs a reduction instead.
+
+    The libgomp of GCC 12 does not implement OMPT and never starts a tool, so
+    the programs, which are built with g++ against the GOMP ABI, run on
+    LLVM's libomp which also provides that ABI.  g++ calls the same
+    GOMP_barrier() for #pragma omp barrier and for the barrier at the end of
+    a single or loop, so through that ABI all of them count as implicit
+    barriers.  Callbacks cost a few clock reads per construct.  Barriers
+    that the programs build themselves (barrier.h) are not OpenMP constructs
+    and count as compute.
+*/
+
+// OpenMP tool interface
+#include <omp-tools.h>
+
+// Standard IO libraries
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+using namespace std;
+
+#include <stdio.h>
+
+namespace
+{
+    enum Wait { BARRIER_IMPLICIT, BARRIER_EXPLICIT, CRITICAL, LOCK, TASK, NUM_WAITS };
+    char const* const WAIT_NAMES[] = {"impl bar", "expl bar", "critical", "lock/atom", "task"};
+
+    // Cache line aligned so that threads do not share their counters
+    struct alignas(64) ThreadProfile
+    {
+        int number = 0;
+        double region = 0.0, loop = 0.0, held = 0.0;
+        double wait[NUM_WAITS] = {};
+        long int waits[NUM_WAITS] = {};
+        double region_start = 0.0, loop_start = 0.0, wait_start = 0.0, held_start = 0.0;
+    };
+
+    // Never destroyed, libomp finalizes the tool after the static destructors
+    // of this library have run
+    mutex registry_lock;
+    vector<unique_ptr<ThreadProfile>>& threads = *new vector<unique_ptr<ThreadProfile>>;
+    thread_local ThreadProfile* current = nullptr;
+    double tool_start = 0.0;
+
+    double now()
+    {
+        return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    ThreadProfile* me()
+    {
+        if (current == nullptr)
+        {
+            lock_guard<mutex> guard(registry_lock);
+            threads.emplace_back(new ThreadProfile);
+            current = threads.back().get();
+            current->number = (int)threads.size() - 1;
+        }
+        return current;
+    }
+
+    Wait sync_wait(ompt_sync_region_t kind)
+    {
+        switch (kind)
+        {
+            case ompt_sync_region_barrier_explicit:
+                return BARRIER_EXPLICIT;
+            case ompt_sync_region_taskwait:
+            case ompt_sync_region_taskgroup:
+                return TASK;
+            default:
+                return BARRIER_IMPLICIT;
+        }
+    }
+
+    void thread_begin(ompt_thread_t, ompt_data_t* thread_data)
+    {
+        thread_data->ptr = me();
+    }
+
+    void implicit_task(ompt_scope_endpoint_t endpoint, ompt_data_t*, ompt_data_t*, unsigned int, unsigned int,
+                       int flags)
+    {
+        if (flags & ompt_task_initial)
+            return;
+        ThreadProfile* t = me();
+        if (endpoint == ompt_scope_begin)
+            t->region_start = now();
+        else
+            t->region += now() - t->region_start;
+    }
+
+    void work(ompt_work_t wstype, ompt_scope_endpoint_t endpoint, ompt_data_t*, ompt_data_t*, uint64_t,
+              const void*)
+    {
+        if (wstype != ompt_work_loop)
+            return;
+        ThreadProfile* t = me();
+        if (endpoint == ompt_scope_begin)
+            t->loop_start = now();
+        else
+            t->loop += now() - t->loop_start;
+    }
+
+    // Only the waiting part of barriers and task waits, not the reductions
+    // and tasks that run in them
+    void sync_region_wait(ompt_sync_region_t kind, ompt_scope_endpoint_t endpoint, ompt_data_t*, ompt_data_t*,
+                          const void*)
+    {
+        ThreadProfile* t = me();
+        if (endpoint == ompt_scope_begin)
+            t->wait_start = now();
+        else
+        {
+            Wait w = sync_wait(kind);
+            t->wait[w] += now() - t->wait_start;
+            t->waits[w]++;
+        }
+    }
+
+    void mutex_acquire(ompt_mutex_t, unsigned int, unsigned int, ompt_wait_id_t, const void*)
+    {
+        me()->wait_start = now();
+    }
+
+    void mutex_acquired(ompt_mutex_t kind, ompt_wait_id_t, const void*)
+    {
+        ThreadProfile* t = me();
+        double time = now();
+        Wait w = (kind == ompt_mutex_critical) ? CRITICAL : LOCK;
+        t->wait[w] += time - t->wait_start;
+        t->waits[w]++;
+        t->held_start = time;
+    }
+
+    void mutex_released(ompt_mutex_t kind, ompt_wait_id_t, const void*)
+    {
+        ThreadProfile* t = me();
+        if (kind == ompt_mutex_critical)
+            t->held += now() - t->held_start;
+    }
+
+    int initialize(ompt_function_lookup_t lookup, int, ompt_data_t*)
+    {
+        ompt_set_callback_t set_callback = (ompt_set_callback_t)lookup("ompt_set_callback");
+        if (set_callback == NULL)
+            return 0;
+
+        struct { ompt_callbacks_t event; ompt_callback_t callback; } const callbacks[] = {
+            {ompt_callback_thread_begin, (ompt_callback_t)thread_begin},
+            {ompt_callback_implicit_task, (ompt_callback_t)implicit_task},
+            {ompt_callback_work, (ompt_callback_t)work},
+            {ompt_callback_sync_region_wait, (ompt_callback_t)sync_region_wait},
+            {ompt_callback_mutex_acquire, (ompt_callback_t)mutex_acquire},
+            {ompt_callback_mutex_acquired, (ompt_callback_t)mutex_acquired},
+            {ompt_callback_mutex_released, (ompt_callback_t)mutex_released}};
+        for (auto const& c : callbacks)
+            if (set_callback(c.event, c.callback) == ompt_set_never)
+                fprintf(stderr, "omp_profile: the runtime never reports event %d\n", (int)c.event);
+
+        tool_start = now();
+        return 1;
+    }
+
+    // One line per thread and the sum over the threads
+    void finalize(ompt_data_t*)
+    {
+        lock_guard<mutex> guard(registry_lock);
+        fprintf(stderr, "\nOpenMP profile of %zu threads over %.4e s, seconds per thread:\n", threads.size(),
+                now() - tool_start);
+        fprintf(stderr, "%-7s %11s %11s %11s", "thread", "region", "compute", "loops");
+        for (int w = 0; w < NUM_WAITS; ++w)
+            fprintf(stderr, " %11s", WAIT_NAMES[w]);
+        fprintf(stderr, " %11s %7s\n", "crit held", "% wait");
+
+        ThreadProfile sum;
+        for (size_t i = 0; i <= threads.size(); ++i)
+        {
+            ThreadProfile const& t = (i < threads.size()) ? *threads[i] : sum;
+            double waited = 0.0;
+            for (int w = 0; w < NUM_WAITS; ++w)
+                waited += t.wait[w];
+
+            if (i < threads.size())
+                fprintf(stderr, "%-7d", t.number);
+            else
+                fprintf(stderr, "%-7s", "all");
+            fprintf(stderr, " %11.4e %11.4e %11.4e", t.region, max(t.region - waited, 0.0), t.loop);
+            for (int w = 0; w < NUM_WAITS; ++w)
+                fprintf(stderr, " %11.4e", t.wait[w]);
+            fprintf(stderr, " %11.4e %7.2f\n", t.held, t.region > 0.0 ? 100.0 * waited / t.region : 0.0);
+
+            if (i < threads.size())
+            {
+                sum.region += t.region;
+                sum.loop += t.loop;
+                sum.held += t.held;
+                for (int w = 0; w < NUM_WAITS; ++w)
+                {
+                    sum.wait[w] += t.wait[w];
+                    sum.waits[w] += t.waits[w];
+                }
+            }
+        }
+
+        fprintf(stderr, "%-7s %35s", "waits", "");
+        for (int w = 0; w < NUM_WAITS; ++w)
+            fprintf(stderr, " %11ld", sum.waits[w]);
+        fprintf(stderr, "\n");
+    }
+}
+
+extern "C" ompt_start_tool_result_t* ompt_start_tool(unsigned int, const char*)
+{
+    static ompt_start_tool_result_t result = {initialize, finalize, {0}};
+    return &result;
+}
@@ -0,0 +1,176 @@
+/*
+    Checks the accuracy bounds documented in vmath.h.
+
+    Usage: vmath_check [points]
+
+    Every function at every accuracy level is evaluated on random arguments
+    (uniform and spread over the exponents) and on grids across its domain,
+    and compared with the long double libm functions, which carry 11 more
+    bits than a double.  The largest error is reported in units in the last
+    place of the exact result (for exp, sin and cos at HA and LA) or as the
+    relative (exp EP) and absolute (sin and cos EP) error, next to the bound
+    stated in vmath.h.  Signed zeros, infinities, NaN and arguments beyond
+    the range reduction are checked as special cases, and sqrt must match
+    libm bit for bit.  The exit status is 1 if any bound does not hold.
+*/
+
+// Vectorized exp, sincos and sqrt on arrays
+#include "vmath.h"
+
+// Standard io stream and namespace
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include <math.h>
+#include <stdio.h>
+
+// Distance from the exact value in units of the last place of a double
+double ulp_error(double y, long double exact)
+{
+    if (isinf(exact) || isnan(exact))
+        return (y == exact || (isnan(y) && isnan(exact))) ? 0.0 : INFINITY;
+    int exponent;
+    frexpl(exact, &exponent);
+    // Spacing of doubles around exact, subnormals have a fixed spacing
+    long double ulp = ldexpl(1.0L, max(exponent, -1021) - 53);
+    return (double)(fabsl((long double)y - exact) / ulp);
+}
+
+// Uniform points in [low, high], half of them with a random exponent as well
+vector<double> arguments(double low, double high, long int n, mt19937_64& generator)
+{
+    uniform_real_distribution<double> uniform(low, high), unit(-1.0, 1.0);
+    uniform_int_distribution<int> exponent(-30, (int)ceil(log2(max(fabs(low), fabs(high)))));
+    vector<double> x(n);
+    for (long int i = 0; i < n; ++i)
+    {
+        if (i % 2 == 0)
+            x[i] = uniform(generator);
+        else
+            x[i] = min(max(ldexp(unit(generator), exponent(generator)), low), high);
+    }
+    // And an even grid over the whole range
+    for (long int i = 0; i < n / 8; ++i)
+        x[i] = low + (high - low) * i / (n / 8);
+    return x;
+}
+
+bool report(string const& name, double measured, double bound, string const& unit)
+{
+    bool ok = (measured <= bound);
+    printf("%-14s %12.4g %12.4g %-4s %s\n", name.c_str(), measured, bound, unit.c_str(), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+bool check_special(string const& name, double y, double expected)
+{
+    bool ok = (isnan(expected) && isnan(y)) || (y == expected && signbit(y) == signbit(expected));
+    if (!ok)
+        printf("%-14s %12.4g  expected %g  FAILED\n", name.c_str(), y, expected);
+    return ok;
+}
+
+int main(int argc, char* argv[])
+{
+    long int n = (argc > 1) ? stol(argv[1]) : 4000000;
+    mt19937_64 generator(2024);
+    int const levels[3] = {VMATH_HA, VMATH_LA, VMATH_EP};
+    char const* const level_names[3] = {"HA", "LA", "EP"};
+    // The bounds of vmath.h, ulp for HA and LA, relative error for exp EP
+    // and absolute error for sin and cos EP
+    double const exp_bound[3] = {1.0, 3.0, 1e-8};
+    double const trig_bound[3] = {1.0, 3.0, 2e-9};
+    bool ok = true;
+
+    printf("%-14s %12s %12s\n", "function", "max error", "bound");
+
+    // exp over the results that are normal doubles
+    vector<double> x = arguments(-708.0, 709.7, n, generator), y(n);
+    for (int l = 0; l < 3; ++l)
+    {
+        vec_exp(x.data(), y.data(), n, levels[l]);
+        double worst = 0.0;
+        for (long int i = 0; i < n; ++i)
+        {
+            long double exact = expl((long double)x[i]);
+            double error = (levels[l] == VMATH_EP) ? (double)fabsl((y[i] - exact) / exact) : ulp_error(y[i], exact);
+            worst = max(worst, error);
+        }
+        ok &= report(string("exp ") + level_names[l], worst, exp_bound[l], levels[l] == VMATH_EP ? "rel" : "ulp");
+    }
+
+    // sin and cos over the range of the reduction, small arguments in it
+    // as well as the whole of it
+    for (double range : {M_PI / 4, 100.0, 524287.0})
+    {
+        x = arguments(-range, range, n, generator);
+        vector<double> s(n), c(n);
+        for (int l = 0; l < 3; ++l)
+        {
+            vec_sincos(x.data(), s.data(), c.data(), n, levels[l]);
+            double worst_sin = 0.0, worst_cos = 0.0;
+            for (long int i = 0; i < n; ++i)
+            {
+                long double exact_sin = sinl((long double)x[i]), exact_cos = cosl((long double)x[i]);
+                if (levels[l] == VMATH_EP)
+                {
+                    worst_sin = max(worst_sin, (double)fabsl(s[i] - exact_sin));
+                    worst_cos = max(worst_cos, (double)fabsl(c[i] - exact_cos));
+                }
+                else
+                {
+                    worst_sin = max(worst_sin, ulp_error(s[i], exact_sin));
+                    worst_cos = max(worst_cos, ulp_error(c[i], exact_cos));
+                }
+            }
+            char name[32];
+            snprintf(name, sizeof(name), "sin %s %.0f", level_names[l], ceil(range));
+            ok &= report(name, worst_sin, trig_bound[l], levels[l] == VMATH_EP ? "abs" : "ulp");
+            snprintf(name, sizeof(name), "cos %s %.0f", level_names[l], ceil(range));
+            ok &= report(name, worst_cos, trig_bound[l], levels[l] == VMATH_EP ? "abs" : "ulp");
+        }
+    }
+
+    // sqrt is correctly rounded, as is libm's
+    x = arguments(0.0, 1e300, n, generator);
+    vec_sqrt(x.data(), y.data(), n);
+    long int mismatches = 0;
+    for (long int i = 0; i < n; ++i)
+        mismatches += (y[i] != sqrt(x[i]));
+    ok &= report("sqrt", (double)mismatches, 0.0, "diff");
+
+    // Special arguments, through the vector kernels of every level
+    double const special[] = {0.0, -0.0, INFINITY, -INFINITY, NAN, 1e6, -3e9, 1e300, 800.0, -800.0};
+    int const num_special = sizeof(special) / sizeof(special[0]);
+    for (int l = 0; l < 3; ++l)
+    {
+        double e[num_special], s[num_special], c[num_special], r[num_special];
+        vec_exp(special, e, num_special, levels[l]);
+        vec_sincos(special, s, c, num_special, levels[l]);
+        vec_sqrt(special, r, num_special);
+        for (int i = 0; i < num_special; ++i)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "%s(%g) %s", "exp", special[i], level_names[l]);
+            ok &= check_special(name, e[i], exp(special[i]));
+            snprintf(name, sizeof(name), "%s(%g) %s", "sqrt", special[i], level_names[l]);
+            ok &= check_special(name, r[i], sqrt(special[i]));
+            // Beyond the reduction the results are libm's, below they only
+            // have to be exact for zero and NaN
+            if (fabs(special[i]) >= vmath_detail::MAX_REDUCE || special[i] == 0.0 || isnan(special[i]))
+            {
+                snprintf(name, sizeof(name), "%s(%g) %s", "sin", special[i], level_names[l]);
+                ok &= check_special(name, s[i], sin(special[i]));
+                snprintf(name, sizeof(name), "%s(%g) %s", "cos", special[i], level_names[l]);
+                ok &= check_special(name, c[i], cos(special[i]));
+            }
+        }
+    }
+
+    cout << (ok ? "All bounds hold.\n" : "Some bounds do not hold.\n");
+    return ok ? 0 : 1;
+}
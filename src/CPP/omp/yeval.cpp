@@ -1,17 +1,33 @@
 // OpenMP library header
 #include <omp.h>
 
+// Binned accumulators that sum independently of the thread count
+#include "reproducible_sum.h"
+// Vectorized exp, sincos and sqrt on arrays
+#include "vmath.h"
+// Expression templates, the whole expression as one fused loop
+#include "expr.h"
+
 // Standard io stream and namespace
 #include <iostream>
+#include <string>
+#include <vector>
 using namespace std;
 
 #include <math.h>
 
-int main()
+// Usage: yeval [naive|repro] [n] [libm|vmath|expr]
+int main(int argc, char* argv[])
 {
-    int const n = pow(2, 8);
-    int num_threads, i, n_temp;
-    double x, dx, y[n], sum;
+    long int n = pow(2, 8);
+    long int i;
+    int num_threads;
+    double x, dx, sum, start_time;
+    bool reproducible = (argc > 1 && string(argv[1]) == "repro");
+    if (argc > 2)
+        n = stol(argv[2]);
+    string method = (argc > 3) ? argv[3] : "libm";
+    vector<double> y(n);
 
     #ifdef _OPENMP
         cout << "How many threads to use? ";
@@ -21,18 +37,75 @@ int main()
     #endif
 
     dx = 1.0 / (double)(n + 1);
-    #pragma omp parallel for private(x)
-    for (i=0 ; i < n ; i ++)
+    start_time = omp_get_wtime();
+    if (method == "libm")
+    {
+        #pragma omp parallel for private(x)
+        for (i=0 ; i < n ; i ++)
+        {
+            x = i * dx;
+            y[i] = exp(x) * cos(x) * sin(x) * sqrt(5.0 * x + 6.0);
+        }
+    }
+    else if (method == "vmath")
+    {
+        // The same expression a block at a time, each function applied to
+        // the whole block so that it runs in vector registers
+        long int const BLOCK = 256;
+        long int num_blocks = (n + BLOCK - 1) / BLOCK;
+        #pragma omp parallel
+        {
+            double xs[BLOCK], e[BLOCK], s[BLOCK], c[BLOCK], r[BLOCK];
+
+            #pragma omp for schedule(static)
+            for (long int b = 0; b < num_blocks; ++b)
+            {
+                long int first = b * BLOCK, length = min(BLOCK, n - first);
+                for (long int j = 0; j < length; ++j)
+                {
+                    xs[j] = (first + j) * dx;
+                    r[j] = 5.0 * xs[j] + 6.0;
+                }
+                vec_exp(xs, e, length);
+                vec_sincos(xs, s, c, length);
+                vec_sqrt(r, r, length);
+                for (long int j = 0; j < length; ++j)
+                    y[first + j] = e[j] * c[j] * s[j] * r[j];
+            }
+        }
+    }
+    else
     {
-        x = i * dx;
-        y[i] = exp(x) * cos(x) * sin(x) * sqrt(5.0 * x + 6.0);
+        // Written like the libm loop, compiled to a single vectorized loop
+        // with the same kernels as vmath and no temporaries
+        using namespace expr;
+        Array ys(y.data(), n);
+        auto x = dx * index();
+        ys = exp(x) * cos(x) * sin(x) * sqrt(5.0 * x + 6.0);
     }
-    cout << "Filled vector y of length " << n << ".\n";
+    double elapsed = omp_get_wtime() - start_time;
+    cout << "Filled vector y of length " << n << " with " << method;
+    cout << " in " << elapsed << " s, " << n / elapsed / 1e6 << " Mpoints/s.\n";
 
-    #pragma omp parallel for reduction(+ : sum)
-    for (i=0 ; i < n ; i ++)
-        sum = sum + y[i];
-    cout << sum;
+    sum = 0.0;
+    if (reproducible)
+    {
+        // Whole blocks into the accumulators, which is where they are fast
+        long int const BLOCK = 1024;
+        long int num_blocks = (n + BLOCK - 1) / BLOCK;
+        ReproducibleSum total;
+        #pragma omp parallel for reduction(reproducible_sum : total)
+        for (long int b = 0; b < num_blocks; ++b)
+            total.add(&y[b * BLOCK], min(BLOCK, n - b * BLOCK));
+        sum = total.value();
+    }
+    else
+    {
+        #pragma omp parallel for reduction(+ : sum)
+        for (i=0 ; i < n ; i ++)
+            sum = sum + y[i];
+    }
+    cout << sum << " (" << hexfloat << sum << ")\n";
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,116 @@
+/*
+    Compare the work-stealing scheduler with OpenMP on the norm kernel of
+    fine_grain/coarse_grain.
+
+    The kernel sums |x_i| where element i is evaluated reps(i) times.  With
+    the regular pattern every element costs the same, with the irregular one
+    the cost grows linearly along the vector so that equal static slices are
+    badly unbalanced.  Thread counts go up to four times the number of
+    hardware threads to see how each approach copes with oversubscription.
+
+    Usage: bench_scheduler [n] [repetitions] [grain]
+*/
+
+// OpenMP library header
+#include <omp.h>
+
+// Work-stealing scheduler on std::thread
+#include "work_stealing.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+// Number of times element i is evaluated
+inline int reps(long int i, long int n, bool irregular)
+{
+    return irregular ? 1 + (32 * i) / n : 8;
+}
+
+inline double element(const vector<double>& x, long int i, long int n, bool irregular)
+{
+    double value = 0.0;
+    for (int r = reps(i, n, irregular); r > 0; --r)
+        value += sqrt(fabs(x[i]) + r);
+    return value;
+}
+
+int main(int argc, char* argv[])
+{
+    long int n = pow(2, 20);
+    int repetitions = 20;
+    long int grain = 1024;
+    if (argc > 1)
+        n = stol(argv[1]);
+    if (argc > 2)
+        repetitions = stoi(argv[2]);
+    if (argc > 3)
+        grain = stol(argv[3]);
+
+    vector<double> x(n);
+    for (long int i = 0; i < n; ++i)
+        x[i] = (double)i;
+
+    int hardware_threads = thread::hardware_concurrency();
+    vector<int> thread_counts = {1};
+    for (int multiple = 1; multiple <= 4; multiple *= 2)
+        if (multiple * hardware_threads > thread_counts.back())
+            thread_counts.push_back(multiple * hardware_threads);
+
+    cout << "Seconds per reduction, n = " << n << ", grain = " << grain << "\n";
+    cout << "threads   pattern   omp_static   omp_dynamic   work_stealing\n";
+
+    for (size_t t = 0; t < thread_counts.size(); ++t)
+    {
+        int num_threads = thread_counts[t];
+        WorkStealingPool pool(num_threads);
+
+        for (int pattern = 0; pattern < 2; ++pattern)
+        {
+            bool irregular = (pattern == 1);
+            double start_time, sum, t_static, t_dynamic, t_stealing;
+
+            start_time = omp_get_wtime();
+            for (int r = 0; r < repetitions; ++r)
+            {
+                sum = 0.0;
+                #pragma omp parallel for num_threads(num_threads) schedule(static) reduction(+ : sum)
+                for (long int i = 0; i < n; ++i)
+                    sum += element(x, i, n, irregular);
+            }
+            t_static = (omp_get_wtime() - start_time) / repetitions;
+
+            start_time = omp_get_wtime();
+            for (int r = 0; r < repetitions; ++r)
+            {
+                sum = 0.0;
+                #pragma omp parallel for num_threads(num_threads) schedule(dynamic, grain) reduction(+ : sum)
+                for (long int i = 0; i < n; ++i)
+                    sum += element(x, i, n, irregular);
+            }
+            t_dynamic = (omp_get_wtime() - start_time) / repetitions;
+
+            start_time = omp_get_wtime();
+            for (int r = 0; r < repetitions; ++r)
+            {
+                sum = pool.parallel_reduce(0, n, grain, 0.0, [&](long int first, long int last)
+                {
+                    double partial = 0.0;
+                    for (long int i = first; i < last; ++i)
+                        partial += element(x, i, n, irregular);
+                    return partial;
+                }, [](double a, double b) { return a + b; });
+            }
+            t_stealing = (omp_get_wtime() - start_time) / repetitions;
+
+            cout << num_threads << "   " << (irregular ? "irregular" : "regular") << "   ";
+            cout << t_static << "   " << t_dynamic << "   " << t_stealing << "\n";
+        }
+    }
+
+    return 0;
+}
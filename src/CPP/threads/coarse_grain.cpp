@@ -0,0 +1,67 @@
+
+// Work-stealing scheduler on std::thread
+#include "work_stealing.h"
+
+// Standard io stream and namespace
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+// Port of omp/coarse_grain.cpp to the work-stealing scheduler - instead of
+// slicing the vector by hand the range is cut into one piece per thread and
+// the pool hands them out, so a thread that is slow to start does not hold
+// everyone else up.
+//
+// Usage: coarse_grain [num_threads] [n]
+int main(int argc, char* argv[])
+{
+    long int n = pow(2, 10);
+    int num_threads = thread::hardware_concurrency();
+
+    if (argc > 1)
+        num_threads = stoi(argv[1]);
+    if (argc > 2)
+        n = stol(argv[2]);
+
+    vector<double> x(n), y(n);
+    double norm, y_norm, true_norm;
+
+    WorkStealingPool pool(num_threads);
+    cout << "Using the work-stealing scheduler with " << pool.size() << " threads.\n";
+
+    long int points_per_thread = (n + pool.size() - 1) / pool.size();
+    cout << "Points per thread = " << points_per_thread << " / " << n << "\n";
+
+    // Initialize x
+    for (long int i = 0; i < n; ++i)
+        x[i] = (double)i;
+
+    norm = pool.parallel_reduce(0, n, points_per_thread, 0.0, [&](long int first, long int last)
+    {
+        double norm_thread = 0.0;
+        for (long int i = first; i < last; ++i)
+            norm_thread += fabs(x[i]);
+        return norm_thread;
+    }, [](double a, double b) { return a + b; });
+
+    y_norm = pool.parallel_reduce(0, n, points_per_thread, 0.0, [&](long int first, long int last)
+    {
+        double y_norm_thread = 0.0;
+        for (long int i = first; i < last; ++i)
+        {
+            y[i] = x[i] / norm;
+            y_norm_thread += fabs(y[i]);
+        }
+        return y_norm_thread;
+    }, [](double a, double b) { return a + b; });
+
+    true_norm = (double)n * (n - 1) / 2;
+    cout << "Norm of x = " << norm << ", n (n - 1) / 2 = " << true_norm << ".\n";
+    cout << "Norm of y = " << y_norm << ".\n";
+
+    return 0;
+}
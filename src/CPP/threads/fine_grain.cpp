@@ -0,0 +1,68 @@
+
+// Work-stealing scheduler on std::thread
+#include "work_stealing.h"
+
+// Standard io stream and namespace
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+// Port of omp/fine_grain.cpp to the work-stealing scheduler - the loops are
+// handed to the pool in small pieces and idle workers steal what is left.
+//
+// Usage: fine_grain [num_threads] [n] [grain]
+int main(int argc, char* argv[])
+{
+    long int n = pow(2, 10) + 1;
+    int num_threads = thread::hardware_concurrency();
+    long int grain = 64;
+
+    if (argc > 1)
+        num_threads = stoi(argv[1]);
+    if (argc > 2)
+        n = stol(argv[2]);
+    if (argc > 3)
+        grain = stol(argv[3]);
+
+    vector<double> x(n), y(n);
+    double norm, true_x_norm, y_norm;
+
+    WorkStealingPool pool(num_threads);
+    cout << "Using the work-stealing scheduler with " << pool.size() << " threads.\n";
+
+    // Initialize x vector
+    pool.parallel_for(0, n, grain, [&](long int first, long int last)
+    {
+        for (long int i = first; i < last; ++i)
+            x[i] = (double)i;
+    });
+
+    norm = pool.parallel_reduce(0, n, grain, 0.0, [&](long int first, long int last)
+    {
+        double sum = 0.0;
+        for (long int i = first; i < last; ++i)
+            sum += fabs(x[i]);
+        return sum;
+    }, [](double a, double b) { return a + b; });
+
+    y_norm = pool.parallel_reduce(0, n, grain, 0.0, [&](long int first, long int last)
+    {
+        double sum = 0.0;
+        for (long int i = first; i < last; ++i)
+        {
+            y[i] = x[i] / norm;
+            sum += fabs(y[i]);
+        }
+        return sum;
+    }, [](double a, double b) { return a + b; });
+
+    true_x_norm = (double)n * (n - 1) / 2;
+    cout << "Norm of x = " << norm << ", n (n-1) / 2 = " << true_x_norm << ".\n";
+    cout << "Norm of y should be 1, is " << y_norm << ".\n";
+
+    return 0;
+}
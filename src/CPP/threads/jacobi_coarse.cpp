@@ -0,0 +1,120 @@
+/*
+    Solve the Poisson problem
+        u_{xx} = f(x)   x \in [a, b]
+    with 
+        u(a) = alpha, u(b) = beta
+    using Jacobi iterations on the work-stealing scheduler.
+
+    Port of omp/jacobi_coarse.cpp.  Each iteration is a single
+    parallel_reduce that computes the new iterate from the old one and the
+    maximum change, u and u_old are swapped instead of copied.
+
+    Usage: jacobi_coarse [num_threads] [grain]
+*/
+
+// Work-stealing scheduler on std::thread
+#include "work_stealing.h"
+// Vectorized exp on arrays
+#include "vmath.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+int main(int argc, char* argv[])
+{
+    // Problem parameters
+    double const a = 0.0, b = 1.0, alpha = 0.0, beta = 3.0;
+
+    // Numerical parameters
+    long int const MAX_ITERATIONS = pow(2,32);
+    int const PRINT_INTERVAL = 1000;
+
+    // Numerical discretization
+    int N;
+    long int k;
+    double dx, tolerance, du_max;
+    N = 1000;
+    dx = (b - a) / (N + 1);
+    tolerance = 0.1 * pow(dx, 2);
+
+    // Scheduler
+    int num_threads = thread::hardware_concurrency();
+    long int grain;
+    if (argc > 1)
+        num_threads = stoi(argv[1]);
+    WorkStealingPool pool(num_threads);
+    grain = (N + pool.size() - 1) / pool.size();
+    if (argc > 2)
+        grain = stol(argv[2]);
+    cout << "Using the work-stealing scheduler with " << pool.size() << " threads.\n";
+
+    // Work arrays
+    double *x = new double[N + 2];
+    double *u = new double[N + 2];
+    double *u_old = new double[N + 2];
+    double *f = new double[N + 2];
+
+    // Initialize arrays including initial guess
+    pool.parallel_for(0, N + 2, grain, [&](long int first, long int last)
+    {
+        for (long int i = first; i < last; ++i)
+        {
+            x[i] = (double) i * dx + a;
+            u[i] = alpha + x[i] * (beta - alpha);
+            u_old[i] = u[i];
+        }
+        vec_exp(&x[first], &f[first], last - first);
+    });
+
+    // Primary algorithm loop
+    auto start_time = chrono::steady_clock::now();
+    k = 0;
+    while (k < MAX_ITERATIONS)
+    {
+        swap(u, u_old);
+
+        du_max = pool.parallel_reduce(1, N + 1, grain, 0.0, [&](long int first, long int last)
+        {
+            double du_max_thread = 0.0;
+            for (long int i = first; i < last; ++i)
+            {
+                u[i] = 0.5 * (u_old[i-1] + u_old[i+1] - pow(dx, 2) * f[i]);
+                du_max_thread = fmax(du_max_thread, fabs(u[i] - u_old[i]));
+            }
+            return du_max_thread;
+        }, [](double a, double b) { return fmax(a, b); });
+
+        if (k%PRINT_INTERVAL == 0)
+            cout << "After " << k + 1 << " iterations, du_max = " << du_max << ".\n";
+
+        if (du_max < tolerance)
+            break;
+
+        k++;
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+    cout << "Jacobi with work stealing took " << k << " iterations and " << elapsed << " s.\n";
+
+    // Check for failure
+    if (k >= MAX_ITERATIONS)
+    {
+        cout << "*** Jacobi failed to converge!\n";
+        cout << "***   Reached du_max = " << du_max << "\n";
+        cout << "***   Tolerance = " << tolerance << "\n";
+        return 1;
+    }
+
+    // Output Results
+    ofstream fp("jacobi_0.txt");
+    for (int i = 0; i < N + 2; ++i)
+        fp << x[i] << " " << u[i] << "\n";
+    fp.close();
+
+    return 0;
+}
@@ -0,0 +1,66 @@
+
+// C++17 parallel algorithms
+#include <algorithm>
+#include <execution>
+#include <functional>
+#include <numeric>
+
+// Standard io stream and namespace
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+using namespace std;
+
+// Math library
+#include <math.h>
+
+// The vector norm demo of omp/fine_grain.cpp and omp/coarse_grain.cpp written
+// with the standard parallel algorithms instead of OpenMP: no thread counts,
+// no index arithmetic, the library decides how to split the work.  With
+// libstdc++ the parallel policies are backed by TBB (link with -ltbb).
+//
+// Usage: norm_stdpar [n] [repetitions]
+int main(int argc, char* argv[])
+{
+    long int n = pow(2, 10);
+    int repetitions = 1;
+    if (argc > 1)
+        n = stol(argv[1]);
+    if (argc > 2)
+        repetitions = max(1, stoi(argv[2]));
+
+    vector<double> x(n), y(n);
+    double norm, y_norm, true_norm;
+
+    // Initialize x in parallel so that the pages are spread like the work
+    double* x_data = x.data();
+    for_each(execution::par_unseq, x.begin(), x.end(), [x_data](double& value)
+    {
+        value = (double)(&value - x_data);
+    });
+
+    auto start_time = chrono::steady_clock::now();
+    for (int r = 0; r < repetitions; ++r)
+    {
+        norm = transform_reduce(execution::par_unseq, x.begin(), x.end(), 0.0, plus<>(),
+                                [](double value) { return fabs(value); });
+
+        transform(execution::par_unseq, x.begin(), x.end(), y.begin(),
+                  [norm](double value) { return value / norm; });
+
+        y_norm = transform_reduce(execution::par_unseq, y.begin(), y.end(), 0.0, plus<>(),
+                                  [](double value) { return fabs(value); });
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start_time).count() / repetitions;
+
+    // Read x, read x and write y, read y
+    double bytes = 4 * 8.0 * n;
+
+    true_norm = (double)n * (n - 1) / 2;
+    cout << "Norm of x = " << norm << ", n (n - 1) / 2 = " << true_norm << ".\n";
+    cout << "Norm of y = " << y_norm << ".\n";
+    cout << "std::execution::par_unseq took " << elapsed << " s, " << bytes / elapsed / 1e9 << " GB/s.\n";
+
+    return 0;
+}